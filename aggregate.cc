@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "aggregate.h"
+
+static String
+time_str(time_t uts_time)
+{
+	char buf[64];
+	struct tm stm;
+
+	localtime_r(&uts_time, &stm);
+	strftime(buf, sizeof(buf) - 1, "%Y-%m-%dT%H:%M:%S%z", &stm);
+	return buf;
+}
+
+void
+Aggregator::setup(JSON& agg_cfg, double interval)
+{
+	// samples further apart are not integrated, e.g. across an outage
+	max_gap = 5 * interval;
+	if (max_gap < 10) {
+		max_gap = 10;
+	}
+	if (agg_cfg.exists("max_gap")) {
+		String tmp = agg_cfg["max_gap"].get_numstr();
+		max_gap = tmp.getd();
+	}
+	if (agg_cfg.exists("fields")) {
+		Array<JSON>& fields = agg_cfg["fields"].get_array();
+		for (int64_t i = 0; i <= fields.max; i++) {
+			String name = fields[i];
+			names[i] = name;
+			energy[i] = false;
+			have_sample[i] = false;
+			sample_value[i] = 0;
+			sample_time[i] = 0;
+		}
+	}
+	if (agg_cfg.exists("energy")) {
+		Array<JSON>& fields = agg_cfg["energy"].get_array();
+		for (int64_t i = 0; i <= fields.max; i++) {
+			String name = fields[i];
+			for (int64_t j = 0; j <= names.max; j++) {
+				if (names[j] == name) {
+					energy[j] = true;
+				}
+			}
+		}
+	}
+	if (agg_cfg.exists("windows")) {
+		Array<JSON>& lengths = agg_cfg["windows"].get_array();
+		for (int64_t i = 0; i <= lengths.max; i++) {
+			Window& window = windows[i];
+			window.length = lengths[i].get_numstr().getll();
+			if (window.length < 1) {
+				window.length = 1;
+			}
+			reset(window, -1);
+		}
+	}
+}
+
+bool
+Aggregator::enabled() const
+{
+	return (names.max >= 0 && windows.max >= 0);
+}
+
+void
+Aggregator::reset(Window& window, int64_t slot)
+{
+	window.slot = slot;
+	for (int64_t i = 0; i <= names.max; i++) {
+		Field& field = window.fields[i];
+		field.count = 0;
+		field.sum = 0;
+		field.min = 0;
+		field.max = 0;
+		field.last = 0;
+		field.energy = 0;
+	}
+}
+
+void
+Aggregator::publish(Window& window, MQTT& mqtt, const String& maintopic, int qos)
+{
+	JSON agg_data;
+	{
+		AArray<JSON> tmp;
+		agg_data = tmp;
+	}
+	agg_data["window"].set_number(S + window.length);
+	agg_data["start"] = time_str(window.slot * window.length);
+	agg_data["end"] = time_str((window.slot + 1) * window.length);
+
+	AArray<JSON> values;
+	for (int64_t i = 0; i <= names.max; i++) {
+		Field& field = window.fields[i];
+		if (field.count == 0) {
+			continue;
+		}
+		AArray<JSON> value;
+		value["count"].set_number(S + field.count);
+		value["min"].set_number(d_to_s(field.min, 3));
+		value["max"].set_number(d_to_s(field.max, 3));
+		value["mean"].set_number(d_to_s(field.sum / field.count, 3));
+		value["last"].set_number(d_to_s(field.last, 3));
+		if (energy[i]) {
+			// power in W integrated over seconds, published as Wh
+			value["energy"].set_number(d_to_s(field.energy / 3600.0, 6));
+		}
+		values[names[i]] = value;
+	}
+	agg_data["values"] = values;
+	mqtt.publish(maintopic + "/agg/" + window.length, agg_data.generate(), false, false, qos);
+}
+
+void
+Aggregator::integrate(Window& window, int64_t i, double t, double val)
+{
+	// trapezoidal rule over the part of the previous sample interval,
+	// which lies within the window
+	double t0 = sample_time[i];
+	double v0 = sample_value[i];
+	double start = (double)window.slot * window.length;
+	double a = (t0 > start) ? t0 : start;
+	double b = (t < start + window.length) ? t : start + window.length;
+	if (b <= a) {
+		return;
+	}
+	double va = v0 + (val - v0) * (a - t0) / (t - t0);
+	double vb = v0 + (val - v0) * (b - t0) / (t - t0);
+	window.fields[i].energy += (va + vb) / 2 * (b - a);
+}
+
+void
+Aggregator::update(JSON& data, const struct timespec& now, MQTT& mqtt, const String& maintopic, int qos)
+{
+	double t = (double)now.tv_sec + (double)now.tv_nsec / 1000000000;
+
+	for (int64_t i = 0; i <= names.max; i++) {
+		if (have_sample[i] && (t <= sample_time[i] || t - sample_time[i] > max_gap)) {
+			have_sample[i] = false;
+		}
+	}
+
+	// windows are aligned to the wall clock, so that all devices and
+	// bridges share the same window boundaries
+	for (int64_t w = 0; w <= windows.max; w++) {
+		Window& window = windows[w];
+		int64_t slot = now.tv_sec / window.length;
+		if (slot != window.slot) {
+			if (window.slot >= 0) {
+				// the energy up to the window end still belongs to it
+				for (int64_t i = 0; i <= names.max; i++) {
+					if (energy[i] && have_sample[i] && data.exists(names[i]) && data[names[i]].is_number()) {
+						integrate(window, i, t, data[names[i]].get_numstr().getd());
+					}
+				}
+				publish(window, mqtt, maintopic, qos);
+			}
+			reset(window, slot);
+		}
+	}
+
+	for (int64_t i = 0; i <= names.max; i++) {
+		if (!data.exists(names[i]) || !data[names[i]].is_number()) {
+			continue;
+		}
+		double val = data[names[i]].get_numstr().getd();
+		for (int64_t w = 0; w <= windows.max; w++) {
+			if (energy[i] && have_sample[i]) {
+				integrate(windows[w], i, t, val);
+			}
+			Field& field = windows[w].fields[i];
+			if (field.count == 0) {
+				field.min = val;
+				field.max = val;
+			} else {
+				if (val < field.min) {
+					field.min = val;
+				}
+				if (val > field.max) {
+					field.max = val;
+				}
+			}
+			field.count++;
+			field.sum += val;
+			field.last = val;
+		}
+		have_sample[i] = true;
+		sample_value[i] = val;
+		sample_time[i] = t;
+	}
+}
+
+void
+Aggregator::tick(const struct timespec& now, MQTT& mqtt, const String& maintopic, int qos)
+{
+	// close windows without a sample after their end, e.g. while the
+	// device is offline, no later sample can bridge to them anymore
+	for (int64_t w = 0; w <= windows.max; w++) {
+		Window& window = windows[w];
+		if (window.slot >= 0 && now.tv_sec >= (window.slot + 1) * window.length + max_gap) {
+			publish(window, mqtt, maintopic, qos);
+			reset(window, -1);
+		}
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_AGGREGATE
+#define I_AGGREGATE
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include "mqtt.h"
+
+class Aggregator : public Base {
+private:
+	struct Field {
+		uint64_t count;
+		double sum;
+		double min;
+		double max;
+		double last;
+		double energy;
+	};
+	struct Window {
+		int64_t length;
+		int64_t slot;
+		Array<Field> fields;
+	};
+	Array<String> names;
+	Array<bool> energy;
+	Array<bool> have_sample;
+	Array<double> sample_value;
+	Array<double> sample_time;
+	Array<Window> windows;
+	double max_gap;
+
+	void reset(Window& window, int64_t slot);
+	void publish(Window& window, MQTT& mqtt, const String& maintopic, int qos);
+	void integrate(Window& window, int64_t i, double t, double val);
+
+public:
+	void setup(JSON& agg_cfg, double interval);
+	bool enabled() const;
+	void update(JSON& data, const struct timespec& now, MQTT& mqtt, const String& maintopic, int qos);
+	void tick(const struct timespec& now, MQTT& mqtt, const String& maintopic, int qos);
+};
+
+#endif /* I_AGGREGATE */
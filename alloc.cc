@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "alloc.h"
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <atomic>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// glibc declares the allocator functions as not throwing
+#ifndef __THROW
+#define __THROW
+#endif
+
+// Replaces the C allocator entry points and forwards to the next
+// definition, unless the calling thread has an active arena.
+
+#define ARENA_CHUNK (64 * 1024)
+#define ARENA_CHUNKS 2048	// 128M of address space, only used chunks get memory
+#define ARENA_MAX (ARENA_CHUNK / 4)
+#define ARENA_HEADER 16		// size of the allocation, keeps 16 byte alignment
+
+struct ArenaChunk {
+	// allocations not freed yet, plus one while an arena allocates from it
+	std::atomic<int64_t> live;
+	int32_t next;
+};
+
+// the current chunk of the thread and the bump offset into it
+struct ArenaState {
+	bool active;
+	int32_t chunk;
+	size_t used;
+};
+
+static std::atomic<char*> arena_base(NULL);
+static ArenaChunk arena_chunks[ARENA_CHUNKS];
+static int32_t arena_free = -1;
+static int32_t arena_unused = 0;
+static pthread_mutex_t arena_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static thread_local ArenaState arena = {false, -1, 0};
+
+#ifdef ALLOC_STATS
+static thread_local uint64_t allocations = 0;
+static thread_local uint64_t arena_allocations = 0;
+#define COUNT_HEAP() allocations++
+#define COUNT_ARENA() arena_allocations++
+#else
+#define COUNT_HEAP()
+#define COUNT_ARENA()
+#endif
+
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+#ifdef __GLIBC__
+static size_t (*real_malloc_usable_size)(void *);
+#endif
+
+// dlsym may allocate before the real functions are known
+static char bootstrap[4096] __attribute__((aligned(16)));
+static size_t bootstrap_used = 0;
+static bool resolving = false;
+
+static void*
+bootstrap_alloc(size_t size)
+{
+	size = (size + 15) & ~(size_t)15;
+	if (bootstrap_used + size > sizeof(bootstrap)) {
+		return NULL;
+	}
+	void *ret = bootstrap + bootstrap_used;
+	bootstrap_used += size;
+	return ret;
+}
+
+static bool
+is_bootstrap(void *ptr)
+{
+	return ((char*)ptr >= bootstrap && (char*)ptr < bootstrap + sizeof(bootstrap));
+}
+
+static void
+resolve()
+{
+	resolving = true;
+	real_malloc = (void *(*)(size_t))dlsym(RTLD_NEXT, "malloc");
+	real_calloc = (void *(*)(size_t, size_t))dlsym(RTLD_NEXT, "calloc");
+	real_realloc = (void *(*)(void *, size_t))dlsym(RTLD_NEXT, "realloc");
+	real_free = (void (*)(void *))dlsym(RTLD_NEXT, "free");
+	real_posix_memalign = (int (*)(void **, size_t, size_t))dlsym(RTLD_NEXT, "posix_memalign");
+	real_aligned_alloc = (void *(*)(size_t, size_t))dlsym(RTLD_NEXT, "aligned_alloc");
+#ifdef __GLIBC__
+	real_malloc_usable_size = (size_t (*)(void *))dlsym(RTLD_NEXT, "malloc_usable_size");
+#endif
+	resolving = false;
+}
+
+static void
+arena_reserve()
+{
+	// address space only, chunks are made accessible when first used,
+	// so mlockall doesn't pin the whole reservation
+	void *addr = mmap(NULL, (size_t)ARENA_CHUNK * ARENA_CHUNKS, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (addr == MAP_FAILED) {
+		syslog(LOG_ERR, "failed to reserve arena: %s", strerror(errno));
+		return;
+	}
+	arena_base.store((char*)addr);
+}
+
+static int32_t
+chunk_get()
+{
+	bool fresh = false;
+	pthread_mutex_lock(&arena_mtx);
+	int32_t chunk = arena_free;
+	if (chunk >= 0) {
+		arena_free = arena_chunks[chunk].next;
+	} else if (arena_unused < ARENA_CHUNKS) {
+		chunk = arena_unused++;
+		fresh = true;
+	}
+	pthread_mutex_unlock(&arena_mtx);
+	if (fresh && mprotect(arena_base.load() + (size_t)chunk * ARENA_CHUNK, ARENA_CHUNK, PROT_READ | PROT_WRITE) < 0) {
+		return -1;
+	}
+	return chunk;
+}
+
+static void
+chunk_release(int32_t chunk)
+{
+	if (arena_chunks[chunk].live.fetch_sub(1) != 1) {
+		return;
+	}
+	pthread_mutex_lock(&arena_mtx);
+	arena_chunks[chunk].next = arena_free;
+	arena_free = chunk;
+	pthread_mutex_unlock(&arena_mtx);
+}
+
+static void*
+arena_alloc(size_t size)
+{
+	if (size > ARENA_MAX) {
+		return NULL;
+	}
+	size_t need = ARENA_HEADER + ((size + 15) & ~(size_t)15);
+	if (arena.chunk < 0 || arena.used + need > ARENA_CHUNK) {
+		if (arena.chunk >= 0) {
+			chunk_release(arena.chunk);
+			arena.chunk = -1;
+		}
+		int32_t chunk = chunk_get();
+		if (chunk < 0) {
+			return NULL;
+		}
+		arena_chunks[chunk].live.store(1);
+		arena.chunk = chunk;
+		arena.used = 0;
+	}
+	char *ptr = arena_base.load(std::memory_order_relaxed) + (size_t)arena.chunk * ARENA_CHUNK + arena.used;
+	*(size_t*)ptr = size;
+	arena.used += need;
+	arena_chunks[arena.chunk].live.fetch_add(1);
+	COUNT_ARENA();
+	return ptr + ARENA_HEADER;
+}
+
+// alignments the arena gives anyway
+static bool
+arena_alignment(size_t alignment)
+{
+	return (alignment <= 16 && (alignment & (alignment - 1)) == 0);
+}
+
+static bool
+is_arena(const void *ptr)
+{
+	char *base = arena_base.load(std::memory_order_relaxed);
+	return (base != NULL && (char*)ptr >= base && (char*)ptr < base + (size_t)ARENA_CHUNK * ARENA_CHUNKS);
+}
+
+static size_t
+arena_size(const void *ptr)
+{
+	return *(size_t*)((char*)ptr - ARENA_HEADER);
+}
+
+static void
+arena_release(void *ptr)
+{
+	chunk_release(((char*)ptr - arena_base.load(std::memory_order_relaxed)) / ARENA_CHUNK);
+}
+
+ArenaScope::ArenaScope(bool enable) : entered(false)
+{
+	if (!enable || arena.active) {
+		return;
+	}
+	pthread_once(&arena_once, arena_reserve);
+	if (arena_base.load() != NULL) {
+		arena.active = true;
+		entered = true;
+	}
+}
+
+ArenaScope::~ArenaScope()
+{
+	if (!entered) {
+		return;
+	}
+	arena.active = false;
+	// everything freed, so the chunk is filled again from the start,
+	// otherwise the next scope continues behind what is still in use
+	if (arena.chunk >= 0 && arena_chunks[arena.chunk].live.load() == 1) {
+		arena.used = 0;
+	}
+}
+
+bool
+arena_contains(const void *ptr)
+{
+	return is_arena(ptr);
+}
+
+#ifdef ALLOC_STATS
+uint64_t
+alloc_count()
+{
+	return allocations;
+}
+
+uint64_t
+arena_count()
+{
+	return arena_allocations;
+}
+#endif
+
+extern "C" void*
+malloc(size_t size) __THROW
+{
+	if (arena.active) {
+		void *ret = arena_alloc(size);
+		if (ret != NULL) {
+			return ret;
+		}
+	}
+	if (real_malloc == NULL) {
+		if (resolving) {
+			return bootstrap_alloc(size);
+		}
+		resolve();
+	}
+	COUNT_HEAP();
+	return real_malloc(size);
+}
+
+extern "C" void*
+calloc(size_t count, size_t size) __THROW
+{
+	if (arena.active && (size == 0 || count <= ARENA_MAX / size)) {
+		void *ret = arena_alloc(count * size);
+		if (ret != NULL) {
+			// chunks are reused, so clear it
+			memset(ret, 0, count * size);
+			return ret;
+		}
+	}
+	if (real_calloc == NULL) {
+		if (resolving) {
+			// static memory is already zeroed
+			return bootstrap_alloc(count * size);
+		}
+		resolve();
+	}
+	COUNT_HEAP();
+	return real_calloc(count, size);
+}
+
+extern "C" void*
+realloc(void *ptr, size_t size) __THROW
+{
+	if (real_realloc == NULL) {
+		resolve();
+	}
+	// arena memory can't grow in place, it moves to wherever the
+	// calling thread allocates now
+	if (ptr == NULL || is_arena(ptr)) {
+		void *ret = malloc(size);
+		if (ret != NULL && ptr != NULL) {
+			size_t old = arena_size(ptr);
+			memcpy(ret, ptr, (size < old) ? size : old);
+			arena_release(ptr);
+		}
+		return ret;
+	}
+	COUNT_HEAP();
+	if (is_bootstrap(ptr)) {
+		void *ret = real_malloc(size);
+		size_t avail = bootstrap + sizeof(bootstrap) - (char*)ptr;
+		if (ret != NULL) {
+			memcpy(ret, ptr, (size < avail) ? size : avail);
+		}
+		return ret;
+	}
+	return real_realloc(ptr, size);
+}
+
+extern "C" int
+posix_memalign(void **ptr, size_t alignment, size_t size) __THROW
+{
+	if (arena.active && arena_alignment(alignment) && alignment >= sizeof(void*)) {
+		void *ret = arena_alloc(size);
+		if (ret != NULL) {
+			*ptr = ret;
+			return 0;
+		}
+	}
+	if (real_posix_memalign == NULL) {
+		resolve();
+	}
+	COUNT_HEAP();
+	return real_posix_memalign(ptr, alignment, size);
+}
+
+extern "C" void*
+aligned_alloc(size_t alignment, size_t size) __THROW
+{
+	if (arena.active && arena_alignment(alignment)) {
+		void *ret = arena_alloc(size);
+		if (ret != NULL) {
+			return ret;
+		}
+	}
+	if (real_aligned_alloc == NULL) {
+		resolve();
+	}
+	COUNT_HEAP();
+	return real_aligned_alloc(alignment, size);
+}
+
+extern "C" void
+free(void *ptr) __THROW
+{
+	if (ptr == NULL || is_bootstrap(ptr)) {
+		return;
+	}
+	if (is_arena(ptr)) {
+		arena_release(ptr);
+		return;
+	}
+	if (real_free == NULL) {
+		resolve();
+	}
+	real_free(ptr);
+}
+
+#ifdef __GLIBC__
+extern "C" size_t
+malloc_usable_size(void *ptr) __THROW
+{
+	if (ptr == NULL || is_bootstrap(ptr)) {
+		return 0;
+	}
+	if (is_arena(ptr)) {
+		return arena_size(ptr);
+	}
+	if (real_malloc_usable_size == NULL) {
+		resolve();
+	}
+	return real_malloc_usable_size(ptr);
+}
+#endif
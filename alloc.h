@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_ALLOC
+#define I_ALLOC
+
+#include "main.h"
+
+// The C allocator entry points are replaced, so everything a thread
+// allocates while an ArenaScope is active, including operator new and
+// allocations inside libbwct, libc and libmosquitto, comes from a
+// monotonic per thread arena instead of the heap.  Arena memory is
+// handed out from 64k chunks, the arena starts over at the end of the
+// scope if everything was freed again, full chunks are reused once the
+// last allocation from them was freed, no matter by which thread.
+// Memory which outlives the scope keeps its chunk, large allocations,
+// alignments above 16 and an exhausted arena fall back to the heap.
+class ArenaScope {
+private:
+	bool entered;
+
+public:
+	ArenaScope(bool enable);
+	~ArenaScope();
+};
+
+// whether ptr was allocated from an arena
+bool arena_contains(const void *ptr);
+
+#ifdef ALLOC_STATS
+// heap allocations done by the calling thread in debug builds: calls of
+// malloc, calloc, realloc, posix_memalign and aligned_alloc, which
+// includes operator new and allocations inside libc and libraries;
+// allocations served by the arena and memory mapped directly with mmap
+// are not counted
+uint64_t alloc_count();
+// allocations of the calling thread served by its arena
+uint64_t arena_count();
+#endif
+
+#endif /* I_ALLOC */
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../compress.h"
+
+static double
+now()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (double)tp.tv_sec + (double)tp.tv_nsec / 1000000000;
+}
+
+static void
+run(const char *name, const char *mode, Compressor& comp, const String& payload, int64_t iterations)
+{
+	size_t len = comp.compress(payload.c_str(), payload.length()).length();
+	double start = now();
+	for (int64_t n = 0; n < iterations; n++) {
+		comp.compress(payload.c_str(), payload.length());
+	}
+	double elapsed = now() - start;
+	printf("%-24s %-8s %8zu %8zu %14.0f\n", name, mode, payload.length(), len, elapsed * 1000000000 / iterations);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int64_t iterations = 10000;
+	int level = 3;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "l:n:")) != -1) {
+		switch (ch) {
+		case 'l':
+			level = atoi(optarg);
+			break;
+		case 'n':
+			iterations = atoll(optarg);
+			break;
+		default:
+			printf("usage: compress_bench [-l level] [-n iterations] payload.json ...\n");
+			exit(1);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	printf("%-24s %-8s %8s %8s %14s\n", "payload", "mode", "bytes", "zstd", "ns/compress");
+	for (int i = 0; i < argc; i++) {
+		String payload;
+		{
+			File f;
+			f.open(argv[i], O_RDONLY);
+			String json(f);
+			JSON doc;
+			doc.parse(json);
+			payload = doc.generate();
+		}
+		try {
+			Compressor plain;
+			plain.setup(level, "");
+			run(argv[i], "plain", plain, payload, iterations);
+			// the first payload is the dictionary, later ones have the
+			// same keys with other values
+			Compressor dict;
+			dict.setup(level, "");
+			dict.set_dictionary(payload.c_str(), payload.length());
+			std::string later(payload.c_str(), payload.length());
+			for (size_t j = 0; j < later.length(); j++) {
+				if (later[j] >= '0' && later[j] <= '9') {
+					later[j] = '0' + (later[j] - '0' + 3) % 10;
+				}
+			}
+			run(argv[i], "dict", dict, String(later.data(), later.length()), iterations);
+		} catch (...) {
+			printf("built without zstd support\n");
+			return 0;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "../main.h"
+#include "../encoder.h"
+
+// payload size and encoding time per format for the given payloads
+// usage: encoder_bench [-n iterations] payload.json ...
+
+static double
+now()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (double)tp.tv_sec + (double)tp.tv_nsec / 1000000000;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int64_t iterations = 100000;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = atoll(optarg);
+			break;
+		default:
+			printf("usage: encoder_bench [-n iterations] payload.json ...\n");
+			exit(1);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	const char *formats[] = {"json", "cbor", "msgpack"};
+	printf("%-24s %-8s %8s %12s\n", "payload", "format", "bytes", "ns/encode");
+	for (int i = 0; i < argc; i++) {
+		JSON doc;
+		{
+			File f;
+			f.open(argv[i], O_RDONLY);
+			String json(f);
+			doc.parse(json);
+		}
+		for (int format = 0; format < 3; format++) {
+			Encoder enc;
+			enc.set_format(formats[format]);
+			size_t len = enc.encode(doc).length();
+			double start = now();
+			for (int64_t n = 0; n < iterations; n++) {
+				enc.encode(doc);
+			}
+			double elapsed = now() - start;
+			printf("%-24s %-8s %8zu %12.0f\n", argv[i], formats[format], len, elapsed * 1000000000 / iterations);
+		}
+	}
+	return 0;
+}
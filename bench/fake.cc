@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "../main.h"
+#include "fake.h"
+
+FakeTransport::FakeTransport()
+{
+	for (int i = 0; i < 256; i++) {
+		images[i].present = false;
+		images[i].synthetic = false;
+	}
+}
+
+void
+FakeTransport::load_registers(JSON& cfg, std::map<uint16_t, uint16_t>& map)
+{
+	// {"0x3000": [1, 2, 3]} sets 0x3000 to 0x3002
+	Array<String> keys = cfg.get_object().getkeys();
+	for (int64_t i = 0; i <= keys.max; i++) {
+		uint16_t reg = strtoul(keys[i].c_str(), NULL, 0);
+		Array<JSON>& values = cfg[keys[i]].get_array();
+		for (int64_t j = 0; j <= values.max; j++) {
+			map[reg + j] = values[j].get_numstr().getll();
+		}
+	}
+}
+
+void
+FakeTransport::load_bits(JSON& cfg, std::map<uint16_t, bool>& map)
+{
+	Array<String> keys = cfg.get_object().getkeys();
+	for (int64_t i = 0; i <= keys.max; i++) {
+		uint16_t reg = strtoul(keys[i].c_str(), NULL, 0);
+		Array<JSON>& values = cfg[keys[i]].get_array();
+		for (int64_t j = 0; j <= values.max; j++) {
+			bool val = values[j];
+			map[reg + j] = val;
+		}
+	}
+}
+
+void
+FakeTransport::load(const String& file)
+{
+	JSON cfg;
+	{
+		File f;
+		f.open(file, O_RDONLY);
+		String json(f);
+		cfg.parse(json);
+	}
+	Array<JSON>& devices = cfg["devices"].get_array();
+	for (int64_t i = 0; i <= devices.max; i++) {
+		JSON& dev_cfg = devices[i];
+		uint8_t address = dev_cfg["address"].get_numstr().getll();
+		Image& img = images[address];
+		img.present = true;
+		const char *ident[] = {"vendor", "product", "version"};
+		for (int id = 0; id < 3; id++) {
+			if (dev_cfg.exists(ident[id])) {
+				String tmp = dev_cfg[ident[id]];
+				img.ident[id] = tmp;
+			}
+		}
+		if (dev_cfg.exists("input_registers")) {
+			load_registers(dev_cfg["input_registers"], img.input);
+		}
+		if (dev_cfg.exists("holding_registers")) {
+			load_registers(dev_cfg["holding_registers"], img.holding);
+		}
+		if (dev_cfg.exists("discrete_inputs")) {
+			load_bits(dev_cfg["discrete_inputs"], img.discrete);
+		}
+		if (dev_cfg.exists("coils")) {
+			load_bits(dev_cfg["coils"], img.coils);
+		}
+	}
+}
+
+FakeTransport::Image&
+FakeTransport::image(uint8_t address)
+{
+	if (!images[address].present) {
+		throw ModbusError(ModbusError::TIMEOUT, S + "no device at address " + address);
+	}
+	return images[address];
+}
+
+void
+FakeTransport::synthesize(uint8_t address, const String& vendor, const String& product, const String& version)
+{
+	Image& img = images[address];
+	img.present = true;
+	img.synthetic = true;
+	img.ident[0] = vendor;
+	img.ident[1] = product;
+	img.ident[2] = version;
+}
+
+template <class T>
+Array<T>
+FakeTransport::get(Image& img, std::map<uint16_t, T>& map, uint16_t reg, uint16_t count)
+{
+	Array<T> ret;
+	for (int i = count - 1; i >= 0; i--) {
+		auto it = map.find(reg + i);
+		if (it == map.end()) {
+			if (!img.synthetic) {
+				throw ModbusException(0x02);
+			}
+			// stable per register, so repeated polls see the same data
+			it = map.insert(std::make_pair((uint16_t)(reg + i), (T)(((reg + i) * 40503u) >> 4))).first;
+		}
+		ret[i] = it->second;
+	}
+	return ret;
+}
+
+void
+FakeTransport::set_ignore_sequence(bool ignore_sequence)
+{
+}
+
+void
+FakeTransport::set_timeout(double seconds)
+{
+}
+
+Array<uint16_t>
+FakeTransport::read_input_registers(uint8_t address, uint16_t reg, uint16_t count)
+{
+	Image& img = image(address);
+	return get(img, img.input, reg, count);
+}
+
+Array<uint16_t>
+FakeTransport::read_holding_registers(uint8_t address, uint16_t reg, uint16_t count)
+{
+	Image& img = image(address);
+	return get(img, img.holding, reg, count);
+}
+
+Array<bool>
+FakeTransport::read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count)
+{
+	Image& img = image(address);
+	return get(img, img.discrete, reg, count);
+}
+
+Array<bool>
+FakeTransport::read_coils(uint8_t address, uint16_t reg, uint16_t count)
+{
+	Image& img = image(address);
+	return get(img, img.coils, reg, count);
+}
+
+uint16_t
+FakeTransport::read_input_register(uint8_t address, uint16_t reg)
+{
+	Image& img = image(address);
+	return get(img, img.input, reg, 1)[0];
+}
+
+void
+FakeTransport::write_coil(uint8_t address, uint16_t reg, bool value)
+{
+	image(address).coils[reg] = value;
+}
+
+void
+FakeTransport::write_register(uint8_t address, uint16_t reg, uint16_t value)
+{
+	image(address).holding[reg] = value;
+}
+
+String
+FakeTransport::identification(uint8_t address, uint8_t id)
+{
+	Image& img = image(address);
+	if (id > 2 || img.ident[id].empty()) {
+		throw ModbusException(0x02);
+	}
+	return img.ident[id];
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_FAKE
+#define I_FAKE
+
+#include "../main.h"
+#include "../transport.h"
+#include <map>
+
+// canned register images per address for tests and benchmarks, writes
+// change the image, requests outside of the image fail like a device
+// exception and absent addresses like a timeout; synthetic devices
+// answer every request with made up data
+class FakeTransport : public Transport {
+private:
+	struct Image {
+		bool present;
+		bool synthetic;
+		String ident[3];
+		std::map<uint16_t, uint16_t> input;
+		std::map<uint16_t, uint16_t> holding;
+		std::map<uint16_t, bool> discrete;
+		std::map<uint16_t, bool> coils;
+	};
+	Image images[256];
+
+	Image& image(uint8_t address);
+	static void load_registers(JSON& cfg, std::map<uint16_t, uint16_t>& map);
+	static void load_bits(JSON& cfg, std::map<uint16_t, bool>& map);
+	template <class T>
+	static Array<T> get(Image& img, std::map<uint16_t, T>& map, uint16_t reg, uint16_t count);
+
+public:
+	FakeTransport();
+	void load(const String& file);
+	void synthesize(uint8_t address, const String& vendor, const String& product, const String& version);
+	void set_ignore_sequence(bool ignore_sequence);
+	void set_timeout(double seconds);
+	Array<uint16_t> read_input_registers(uint8_t address, uint16_t reg, uint16_t count);
+	Array<uint16_t> read_holding_registers(uint8_t address, uint16_t reg, uint16_t count);
+	Array<bool> read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count);
+	Array<bool> read_coils(uint8_t address, uint16_t reg, uint16_t count);
+	uint16_t read_input_register(uint8_t address, uint16_t reg);
+	void write_coil(uint8_t address, uint16_t reg, bool value);
+	void write_register(uint8_t address, uint16_t reg, uint16_t value);
+	String identification(uint8_t address, uint8_t id);
+};
+
+#endif /* I_FAKE */
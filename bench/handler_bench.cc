@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../device.h"
+#include "../alloc.h"
+#include "fake.h"
+
+static double
+now()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (double)tp.tv_sec + (double)tp.tv_nsec / 1000000000;
+}
+
+// one poll as the bus thread does it, without publishing
+static void
+poll(Bus& mb, Device& dev, bool arena)
+{
+	ArenaScope arena_scope(arena);
+	JSON mqtt_data;
+	{
+		AArray<JSON> tmp;
+		mqtt_data = tmp;
+	}
+	mqtt_data["vendor"] = dev.vendor;
+	mqtt_data["product"] = dev.product;
+	mqtt_data["version"] = dev.version;
+	Array<MQTT::RXbuf> rxbuf;
+	mb.begin_poll();
+	(*dev.handler)(mb, rxbuf, mqtt_data, dev.address, dev, *dev.cfg);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int64_t iterations = 10000;
+	bool arena = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "an:")) != -1) {
+		switch (ch) {
+		case 'a':
+			arena = true;
+			break;
+		case 'n':
+			iterations = atoll(optarg);
+			break;
+		default:
+			printf("usage: handler_bench [-a] [-n iterations]\n");
+			exit(1);
+		}
+	}
+
+	AArray<AArray<devfunction>> devfunctions;
+	register_handlers(devfunctions);
+
+	printf("%10s %12s  %s\n", "ns/poll", "allocs/poll", "device");
+	Array<String> vendors = devfunctions.getkeys();
+	for (int64_t v = 0; v <= vendors.max; v++) {
+		Array<String> products = devfunctions[vendors[v]].getkeys();
+		for (int64_t p = 0; p <= products.max; p++) {
+			// every register answers, blocks of slower rate classes are
+			// cached by the Bus like in the bridge
+			FakeTransport *fake = new FakeTransport;
+			fake->synthesize(1, vendors[v], products[p], "1.10");
+			Bus mb(fake);
+			JSON dev_cfg;
+			{
+				AArray<JSON> tmp;
+				dev_cfg = tmp;
+			}
+			Device dev;
+			dev.cfg = &dev_cfg;
+			dev.address = 1;
+			dev.vendor = vendors[v];
+			dev.product = products[p];
+			dev.version = "1.10";
+			dev.major = 1;
+			dev.minor = 10;
+			dev.handler = devfunctions[vendors[v]][products[p]];
+
+			try {
+				poll(mb, dev, arena);
+				uint64_t allocations = alloc_count();
+				double start = now();
+				for (int64_t n = 0; n < iterations; n++) {
+					poll(mb, dev, arena);
+				}
+				double elapsed = now() - start;
+				printf("%10.0f %12.1f  %s %s\n", elapsed * 1000000000 / iterations,
+				    (double)(alloc_count() - allocations) / iterations, vendors[v].c_str(), products[p].c_str());
+			} catch (...) {
+				printf("%10s %12s  %s %s\n", "failed", "-", vendors[v].c_str(), products[p].c_str());
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../device.h"
+#include "../compress.h"
+#include "../clock.h"
+#include "fake.h"
+#include <sys/stat.h>
+
+// writes the zstd dictionary of every registered handler: the payload of
+// one poll against a synthetic device, so it holds the key set of the
+// handler in the order the bridge publishes it
+int
+main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("usage: zdict_gen outdir\n");
+		exit(1);
+	}
+	String outdir = argv[1];
+	mkdir(outdir.c_str(), 0755);
+
+	AArray<AArray<devfunction>> devfunctions;
+	register_handlers(devfunctions);
+
+	Array<String> vendors = devfunctions.getkeys();
+	for (int64_t v = 0; v <= vendors.max; v++) {
+		Array<String> products = devfunctions[vendors[v]].getkeys();
+		for (int64_t p = 0; p <= products.max; p++) {
+			FakeTransport *fake = new FakeTransport;
+			fake->synthesize(1, vendors[v], products[p], "1.10");
+			Bus mb(fake);
+			JSON dev_cfg;
+			{
+				AArray<JSON> tmp;
+				dev_cfg = tmp;
+			}
+			Device dev;
+			dev.cfg = &dev_cfg;
+			dev.address = 1;
+			dev.vendor = vendors[v];
+			dev.product = products[p];
+			dev.version = "1.10";
+			dev.major = 1;
+			dev.minor = 10;
+			dev.handler = devfunctions[vendors[v]][products[p]];
+
+			String name = Compressor::dictionary_name(vendors[v], products[p]);
+			String file = outdir + "/" + name;
+			try {
+				JSON mqtt_data;
+				{
+					AArray<JSON> tmp;
+					mqtt_data = tmp;
+				}
+				mqtt_data["vendor"] = dev.vendor;
+				mqtt_data["product"] = dev.product;
+				mqtt_data["version"] = dev.version;
+				Array<MQTT::RXbuf> rxbuf;
+				mb.begin_poll();
+				(*dev.handler)(mb, rxbuf, mqtt_data, dev.address, dev, *dev.cfg);
+				mqtt_data["time"] = clock_string(time(NULL));
+				String payload = mqtt_data.generate();
+
+				mkdir((outdir + "/" + name.split("/")[0]).c_str(), 0755);
+				File f;
+				f.open(file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+				f.write(payload);
+				f.close();
+				printf("%6zu  %s\n", (size_t)payload.length(), name.c_str());
+			} catch (...) {
+				// the bridge uses the first payload instead
+				printf("%6s  %s\n", "failed", name.c_str());
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,650 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "bus.h"
+#include "trace.h"
+
+static const char *block_types[] = {"input_registers", "holding_registers", "discrete_inputs", "coils"};
+static const char *rate_names[] = {"fast", "normal", "slow", "static"};
+
+#define BLOCK_KEY(type, reg) (((uint32_t)(type) << 16) | (reg))
+
+Bus::Bus(const String& host, const String& port)
+{
+	transport = new ModbusTransport(host, port);
+	init();
+}
+
+Bus::Bus(Transport *transport)
+{
+	this->transport = transport;
+	init();
+}
+
+void
+Bus::init()
+{
+	for (int i = 0; i < 256; i++) {
+		Stats& s = stats[i];
+		memset(s.rtt_hist, 0, sizeof(s.rtt_hist));
+		s.count = 0;
+		s.have_errors = false;
+		s.record_times = false;
+		cache[i].enabled = false;
+		cache[i].verify = 0;
+		blocks[i].interval[RATE_FAST] = 0;
+		blocks[i].interval[RATE_NORMAL] = 10;
+		blocks[i].interval[RATE_SLOW] = 60;
+		blocks[i].interval[RATE_STATIC] = -1;
+		writes[i] = 0;
+	}
+	retries = 1;
+	min_budget = 0.2;
+	max_budget = 5.0;
+	min_timeout = 0.05;
+	ok_blocks = 0;
+	failed_blocks = 0;
+	busy = 0;
+}
+
+void
+Bus::set_ignore_sequence(bool ignore_sequence)
+{
+	transport->set_ignore_sequence(ignore_sequence);
+}
+
+void
+Bus::set_retries(int count)
+{
+	retries = (count < 0) ? 0 : count;
+}
+
+void
+Bus::set_budget(double min_budget, double max_budget)
+{
+	this->min_budget = min_budget;
+	this->max_budget = max_budget;
+}
+
+void
+Bus::set_write_cache(uint8_t address, double verify)
+{
+	cache[address].enabled = true;
+	cache[address].verify = verify;
+}
+
+int
+Bus::parse_rate(const String& name)
+{
+	for (int i = 0; i < RATE_CLASSES; i++) {
+		if (name == rate_names[i]) {
+			return i;
+		}
+	}
+	throw Error(S + "unknown rate class " + name);
+}
+
+void
+Bus::set_rate_interval(uint8_t address, int rate, double interval)
+{
+	if (rate != RATE_FAST && rate != RATE_STATIC) {
+		blocks[address].interval[rate] = interval;
+	}
+}
+
+void
+Bus::set_block_rate(uint8_t address, const String& block, int rate)
+{
+	// blocks are named like in the error counters: holding_registers@0x9000
+	Array<String> parts = block.split("@");
+	if (parts.max != 1) {
+		throw Error(S + "invalid block " + block);
+	}
+	for (int type = 0; type < BLOCK_TYPES; type++) {
+		if (parts[0] == block_types[type]) {
+			uint16_t reg = strtoul(parts[1].c_str(), NULL, 0);
+			blocks[address].rates[BLOCK_KEY(type, reg)] = rate;
+			return;
+		}
+	}
+	throw Error(S + "invalid block " + block);
+}
+
+void
+Bus::invalidate(uint8_t address)
+{
+	// the device may have been restarted or replaced, so read all again
+	blocks[address].registers.clear();
+	blocks[address].bits.clear();
+}
+
+double
+Bus::now()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (double)tp.tv_sec + (double)tp.tv_nsec / 1000000000;
+}
+
+void
+Bus::record_rtt(uint8_t address, double rtt)
+{
+	Stats& s = stats[address];
+	uint64_t us = rtt * 1000000;
+	int bucket = 0;
+	while (bucket < 31 && us >= ((uint64_t)2 << bucket)) {
+		bucket++;
+	}
+	s.rtt_hist[bucket]++;
+	s.count++;
+}
+
+double
+Bus::rtt_percentile(uint8_t address, double percentile)
+{
+	Stats& s = stats[address];
+	if (s.count == 0) {
+		return 0;
+	}
+	uint64_t limit = s.count * percentile / 100;
+	uint64_t sum = 0;
+	int bucket;
+	for (bucket = 0; bucket < 31; bucket++) {
+		sum += s.rtt_hist[bucket];
+		if (sum > limit) {
+			break;
+		}
+	}
+	// upper bound of the bucket
+	return (double)((uint64_t)2 << bucket) / 1000000;
+}
+
+double
+Bus::busy_time() const
+{
+	// seconds spent in transactions, including failed ones
+	return busy;
+}
+
+double
+Bus::budget(uint8_t address)
+{
+	// time we are willing to spend on one request including retries,
+	// learned from what the device usually needs once we have seen enough
+	if (stats[address].count < min_samples) {
+		return max_budget;
+	}
+	double ret = rtt_percentile(address, 99) * (retries + 1) * 2;
+	if (ret < min_budget) {
+		ret = min_budget;
+	}
+	if (ret > max_budget) {
+		ret = max_budget;
+	}
+	return ret;
+}
+
+void
+Bus::failed(uint8_t address, const char *type, uint16_t reg)
+{
+	Stats& s = stats[address];
+	String key;
+	key.printf("%s@0x%04x", type, reg);
+	s.block_errors[key]++;
+	s.have_errors = true;
+	failed_blocks++;
+}
+
+void
+Bus::acquired(uint8_t address, const char *type, uint16_t reg, const struct timespec& tp)
+{
+	String key;
+	key.printf("%s@0x%04x", type, reg);
+	String value;
+	value.printf("%jd.%03ld", (intmax_t)tp.tv_sec, tp.tv_nsec / 1000000);
+	stats[address].block_times[key] = value;
+}
+
+void
+Bus::set_block_timestamps(uint8_t address, bool enable)
+{
+	stats[address].record_times = enable;
+}
+
+void
+Bus::block_timestamps(uint8_t address, JSON& out)
+{
+	Stats& s = stats[address];
+	if (!s.record_times) {
+		return;
+	}
+	AArray<JSON> times;
+	Array<String> keys = s.block_times.getkeys();
+	for (int64_t i = 0; i <= keys.max; i++) {
+		times[keys[i]].set_number(s.block_times[keys[i]]);
+	}
+	out["block_times"] = times;
+}
+
+template <class F>
+auto
+Bus::transaction(uint8_t address, const char *type, uint16_t reg, F fn) -> decltype(fn())
+{
+	double start = now();
+	double limit = budget(address);
+	for (int attempt = 0;; attempt++) {
+		double begin = now();
+		// what is left of the budget is split over the remaining attempts,
+		// so a lost frame still leaves time for a retry
+		double timeout = (limit - (begin - start)) / (retries - attempt + 1);
+		if (timeout < min_timeout) {
+			timeout = min_timeout;
+		}
+		transport->set_timeout(timeout);
+		TraceSpan span(type);
+		struct timespec tp;
+		if (stats[address].record_times) {
+			clock_gettime(CLOCK_REALTIME, &tp);
+		}
+		try {
+			auto ret = fn();
+			double rtt = now() - begin;
+			if (stats[address].record_times) {
+				acquired(address, type, reg, tp);
+			}
+			record_rtt(address, rtt);
+			busy += rtt;
+			ok_blocks++;
+			return ret;
+		} catch (ModbusError& e) {
+			busy += now() - begin;
+			// exception replies are answered the same way again
+			if (!e.retryable() || attempt >= retries || now() - start >= limit) {
+				failed(address, type, reg);
+				throw;
+			}
+		} catch (...) {
+			busy += now() - begin;
+			failed(address, type, reg);
+			throw;
+		}
+	}
+}
+
+template <class T>
+bool
+Bus::cache_lookup(std::map<uint16_t, CacheEntry<T>>& map, double verify, uint16_t reg, uint16_t count, Array<T>& out)
+{
+	// only served if the whole block was read back recently enough
+	double limit = now() - verify;
+	for (int i = count - 1; i >= 0; i--) {
+		auto it = map.find(reg + i);
+		if (it == map.end() || it->second.verified < limit) {
+			return false;
+		}
+		out[i] = it->second.value;
+	}
+	return true;
+}
+
+template <class T>
+void
+Bus::cache_store(std::map<uint16_t, CacheEntry<T>>& map, uint16_t reg, const Array<T>& data)
+{
+	double t = now();
+	for (int64_t i = 0; i <= data.max; i++) {
+		CacheEntry<T>& entry = map[reg + i];
+		entry.value = data[i];
+		entry.verified = t;
+	}
+}
+
+template <class T>
+void
+Bus::cache_write(std::map<uint16_t, CacheEntry<T>>& map, uint16_t reg, T value)
+{
+	auto it = map.find(reg);
+	if (it != map.end()) {
+		it->second.value = value;
+	}
+}
+
+double
+Bus::block_interval(uint8_t address, int type, uint16_t reg, int rate)
+{
+	Blocks& b = blocks[address];
+	if (!b.rates.empty()) {
+		auto it = b.rates.find(BLOCK_KEY(type, reg));
+		if (it != b.rates.end()) {
+			rate = it->second;
+		}
+	}
+	return b.interval[rate];
+}
+
+template <class T>
+bool
+Bus::block_lookup(std::map<uint32_t, Block<T>>& map, uint32_t key, uint16_t count, double interval, Array<T>& out)
+{
+	if (interval == 0) {
+		return false;
+	}
+	auto it = map.find(key);
+	if (it == map.end() || it->second.data.max + 1 < count) {
+		return false;
+	}
+	if (interval > 0 && now() - it->second.time >= interval) {
+		return false;
+	}
+	for (int i = count - 1; i >= 0; i--) {
+		out[i] = it->second.data[i];
+	}
+	return true;
+}
+
+template <class T>
+void
+Bus::block_store(std::map<uint32_t, Block<T>>& map, uint32_t key, const Array<T>& data)
+{
+	Block<T>& block = map[key];
+	block.data = data;
+	block.time = now();
+}
+
+template <class T>
+void
+Bus::block_write(std::map<uint32_t, Block<T>>& map, int type, uint16_t reg, T value)
+{
+	// keep cached blocks in line with what we wrote
+	for (auto it = map.begin(); it != map.end(); ++it) {
+		uint16_t start = it->first & 0xffff;
+		if ((int)(it->first >> 16) == type && reg >= start && reg <= start + it->second.data.max) {
+			it->second.data[reg - start] = value;
+		}
+	}
+}
+
+template <class T>
+void
+Bus::block_erase(std::map<uint32_t, Block<T>>& map, int type, uint16_t reg)
+{
+	// blocks with a register of unknown state are read again
+	for (auto it = map.begin(); it != map.end();) {
+		uint16_t start = it->first & 0xffff;
+		if ((int)(it->first >> 16) == type && reg >= start && reg <= start + it->second.data.max) {
+			it = map.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void
+Bus::begin_poll()
+{
+	ok_blocks = 0;
+	failed_blocks = 0;
+}
+
+bool
+Bus::poll_failed() const
+{
+	// a device without a single good block is considered offline
+	return (failed_blocks > 0 && ok_blocks == 0);
+}
+
+void
+Bus::error_counters(uint8_t address, JSON& out)
+{
+	Stats& s = stats[address];
+	if (!s.have_errors) {
+		return;
+	}
+	AArray<JSON> counters;
+	Array<String> keys = s.block_errors.getkeys();
+	for (int64_t i = 0; i <= keys.max; i++) {
+		counters[keys[i]].set_number(S + s.block_errors[keys[i]]);
+	}
+	out["block_errors"] = counters;
+}
+
+Array<uint16_t>
+Bus::read_input_registers(uint8_t address, uint16_t reg, uint16_t count, int rate)
+{
+	Blocks& b = blocks[address];
+	uint32_t key = BLOCK_KEY(BLOCK_INPUT, reg);
+	double interval = block_interval(address, BLOCK_INPUT, reg, rate);
+	Array<uint16_t> ret;
+	if (block_lookup(b.registers, key, count, interval, ret)) {
+		return ret;
+	}
+	ret = transaction(address, "input_registers", reg, [&]() {
+		return transport->read_input_registers(address, reg, count);
+	});
+	if (interval != 0) {
+		block_store(b.registers, key, ret);
+	}
+	return ret;
+}
+
+Array<uint16_t>
+Bus::read_holding_registers(uint8_t address, uint16_t reg, uint16_t count, int rate)
+{
+	Blocks& b = blocks[address];
+	uint32_t key = BLOCK_KEY(BLOCK_HOLDING, reg);
+	double interval = block_interval(address, BLOCK_HOLDING, reg, rate);
+	Array<uint16_t> ret;
+	if (block_lookup(b.registers, key, count, interval, ret)) {
+		return ret;
+	}
+	Cache& c = cache[address];
+	if (c.enabled) {
+		if (cache_lookup(c.registers, c.verify, reg, count, ret)) {
+			return ret;
+		}
+	}
+	ret = transaction(address, "holding_registers", reg, [&]() {
+		return transport->read_holding_registers(address, reg, count);
+	});
+	if (c.enabled) {
+		cache_store(c.registers, reg, ret);
+	}
+	if (interval != 0) {
+		block_store(b.registers, key, ret);
+	}
+	return ret;
+}
+
+Array<bool>
+Bus::read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count, int rate)
+{
+	Blocks& b = blocks[address];
+	uint32_t key = BLOCK_KEY(BLOCK_DISCRETE, reg);
+	double interval = block_interval(address, BLOCK_DISCRETE, reg, rate);
+	Array<bool> ret;
+	if (block_lookup(b.bits, key, count, interval, ret)) {
+		return ret;
+	}
+	ret = transaction(address, "discrete_inputs", reg, [&]() {
+		return transport->read_discrete_inputs(address, reg, count);
+	});
+	if (interval != 0) {
+		block_store(b.bits, key, ret);
+	}
+	return ret;
+}
+
+Array<bool>
+Bus::read_coils(uint8_t address, uint16_t reg, uint16_t count, int rate)
+{
+	Blocks& b = blocks[address];
+	uint32_t key = BLOCK_KEY(BLOCK_COILS, reg);
+	double interval = block_interval(address, BLOCK_COILS, reg, rate);
+	Array<bool> ret;
+	if (block_lookup(b.bits, key, count, interval, ret)) {
+		return ret;
+	}
+	Cache& c = cache[address];
+	if (c.enabled) {
+		if (cache_lookup(c.coils, c.verify, reg, count, ret)) {
+			return ret;
+		}
+	}
+	ret = transaction(address, "coils", reg, [&]() {
+		return transport->read_coils(address, reg, count);
+	});
+	if (c.enabled) {
+		cache_store(c.coils, reg, ret);
+	}
+	if (interval != 0) {
+		block_store(b.bits, key, ret);
+	}
+	return ret;
+}
+
+uint16_t
+Bus::read_input_register(uint8_t address, uint16_t reg)
+{
+	return transaction(address, "input_registers", reg, [&]() {
+		return transport->read_input_register(address, reg);
+	});
+}
+
+void
+Bus::write_coil(uint8_t address, uint16_t reg, bool value)
+{
+	Cache& c = cache[address];
+	writes[address]++;
+	try {
+		transaction(address, "write_coil", reg, [&]() {
+			transport->write_coil(address, reg, value);
+			return true;
+		});
+	} catch (...) {
+		// we don't know what the device has now
+		c.coils.erase(reg);
+		block_erase(blocks[address].bits, BLOCK_COILS, reg);
+		throw;
+	}
+	if (c.enabled) {
+		cache_write(c.coils, reg, value);
+	}
+	block_write(blocks[address].bits, BLOCK_COILS, reg, value);
+}
+
+void
+Bus::write_register(uint8_t address, uint16_t reg, uint16_t value)
+{
+	Cache& c = cache[address];
+	writes[address]++;
+	try {
+		transaction(address, "write_register", reg, [&]() {
+			transport->write_register(address, reg, value);
+			return true;
+		});
+	} catch (...) {
+		// we don't know what the device has now
+		c.registers.erase(reg);
+		block_erase(blocks[address].registers, BLOCK_HOLDING, reg);
+		throw;
+	}
+	if (c.enabled) {
+		cache_write(c.registers, reg, value);
+	}
+	block_write(blocks[address].registers, BLOCK_HOLDING, reg, value);
+}
+
+uint64_t
+Bus::write_count(uint8_t address) const
+{
+	// changes with every write of the bridge, even failed ones
+	return writes[address];
+}
+
+void
+Bus::direct(uint8_t address, uint8_t function, uint16_t reg, uint16_t count, Array<uint16_t>& registers, Array<bool>& bits)
+{
+	// proxy traffic: a single attempt, which neither uses the caches nor
+	// counts for the statistics of the device, the client retries itself
+	Cache& c = cache[address];
+	transport->set_timeout(budget(address));
+	double begin = now();
+	try {
+		switch (function) {
+		case 0x01:
+			bits = transport->read_coils(address, reg, count);
+			break;
+		case 0x02:
+			bits = transport->read_discrete_inputs(address, reg, count);
+			break;
+		case 0x03:
+			registers = transport->read_holding_registers(address, reg, count);
+			break;
+		case 0x04:
+			registers = transport->read_input_registers(address, reg, count);
+			break;
+		case 0x05:
+			transport->write_coil(address, reg, count == 0xff00);
+			break;
+		case 0x06:
+			transport->write_register(address, reg, count);
+			break;
+		}
+	} catch (...) {
+		busy += now() - begin;
+		// we don't know what the device has now
+		if (function == 0x05) {
+			c.coils.erase(reg);
+			block_erase(blocks[address].bits, BLOCK_COILS, reg);
+		} else if (function == 0x06) {
+			c.registers.erase(reg);
+			block_erase(blocks[address].registers, BLOCK_HOLDING, reg);
+		}
+		throw;
+	}
+	busy += now() - begin;
+	// what the bridge has cached must follow writes of the client
+	if (function == 0x05) {
+		cache_write(c.coils, reg, count == 0xff00);
+		block_write(blocks[address].bits, BLOCK_COILS, reg, count == 0xff00);
+	} else if (function == 0x06) {
+		cache_write(c.registers, reg, count);
+		block_write(blocks[address].registers, BLOCK_HOLDING, reg, count);
+	}
+}
+
+String
+Bus::identification(uint8_t address, uint8_t id)
+{
+	return transaction(address, "identification", id, [&]() {
+		return transport->identification(address, id);
+	});
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_BUS
+#define I_BUS
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <map>
+#include "transport.h"
+
+// Modbus transactions of one bus thread with per device retries and
+// statistics, the device handlers only talk to the bus through this
+class Bus : public Base {
+public:
+	// how often a register block is read, fast blocks on every poll
+	enum {
+		RATE_FAST,
+		RATE_NORMAL,
+		RATE_SLOW,
+		RATE_STATIC,
+		RATE_CLASSES
+	};
+private:
+	enum {
+		BLOCK_INPUT,
+		BLOCK_HOLDING,
+		BLOCK_DISCRETE,
+		BLOCK_COILS,
+		BLOCK_TYPES
+	};
+	struct Stats {
+		uint64_t rtt_hist[32];
+		uint64_t count;
+		AArray<uint64_t> block_errors;
+		bool have_errors;
+		bool record_times;
+		AArray<String> block_times;
+	};
+	template <class T>
+	struct CacheEntry {
+		T value;
+		double verified;
+	};
+	// write-through cache of registers and coils only the bridge writes
+	struct Cache {
+		bool enabled;
+		double verify;
+		std::map<uint16_t, CacheEntry<uint16_t>> registers;
+		std::map<uint16_t, CacheEntry<bool>> coils;
+	};
+	template <class T>
+	struct Block {
+		Array<T> data;
+		double time;
+	};
+	// blocks of slower rate classes, keyed by type and start register
+	struct Blocks {
+		double interval[RATE_CLASSES];
+		std::map<uint32_t, int> rates;
+		std::map<uint32_t, Block<uint16_t>> registers;
+		std::map<uint32_t, Block<bool>> bits;
+	};
+	a_ptr<Transport> transport;
+	Stats stats[256];
+	Cache cache[256];
+	Blocks blocks[256];
+	int retries;
+	double min_budget;
+	double max_budget;
+	double min_timeout;
+	static const uint64_t min_samples = 10;
+	int64_t ok_blocks;
+	int64_t failed_blocks;
+	double busy;
+	uint64_t writes[256];
+
+	void init();
+	static double now();
+	void record_rtt(uint8_t address, double rtt);
+	double budget(uint8_t address);
+	void failed(uint8_t address, const char *type, uint16_t reg);
+	void acquired(uint8_t address, const char *type, uint16_t reg, const struct timespec& tp);
+
+	template <class F>
+	auto transaction(uint8_t address, const char *type, uint16_t reg, F fn) -> decltype(fn());
+	template <class T>
+	static bool cache_lookup(std::map<uint16_t, CacheEntry<T>>& map, double verify, uint16_t reg, uint16_t count, Array<T>& out);
+	template <class T>
+	static void cache_store(std::map<uint16_t, CacheEntry<T>>& map, uint16_t reg, const Array<T>& data);
+	template <class T>
+	static void cache_write(std::map<uint16_t, CacheEntry<T>>& map, uint16_t reg, T value);
+	double block_interval(uint8_t address, int type, uint16_t reg, int rate);
+	template <class T>
+	static bool block_lookup(std::map<uint32_t, Block<T>>& map, uint32_t key, uint16_t count, double interval, Array<T>& out);
+	template <class T>
+	static void block_store(std::map<uint32_t, Block<T>>& map, uint32_t key, const Array<T>& data);
+	template <class T>
+	static void block_write(std::map<uint32_t, Block<T>>& map, int type, uint16_t reg, T value);
+	template <class T>
+	static void block_erase(std::map<uint32_t, Block<T>>& map, int type, uint16_t reg);
+
+public:
+	Bus(const String& host, const String& port);
+	Bus(Transport *transport);
+	void set_ignore_sequence(bool ignore_sequence);
+	void set_retries(int count);
+	void set_budget(double min_budget, double max_budget);
+	void set_write_cache(uint8_t address, double verify);
+	static int parse_rate(const String& name);
+	void set_rate_interval(uint8_t address, int rate, double interval);
+	void set_block_rate(uint8_t address, const String& block, int rate);
+	void invalidate(uint8_t address);
+	void begin_poll();
+	bool poll_failed() const;
+	double rtt_percentile(uint8_t address, double percentile);
+	double busy_time() const;
+	void error_counters(uint8_t address, JSON& out);
+	void set_block_timestamps(uint8_t address, bool enable);
+	void block_timestamps(uint8_t address, JSON& out);
+
+	Array<uint16_t> read_input_registers(uint8_t address, uint16_t reg, uint16_t count, int rate = RATE_FAST);
+	Array<uint16_t> read_holding_registers(uint8_t address, uint16_t reg, uint16_t count, int rate = RATE_FAST);
+	Array<bool> read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count, int rate = RATE_FAST);
+	Array<bool> read_coils(uint8_t address, uint16_t reg, uint16_t count, int rate = RATE_FAST);
+	uint16_t read_input_register(uint8_t address, uint16_t reg);
+	void write_coil(uint8_t address, uint16_t reg, bool value);
+	void write_register(uint8_t address, uint16_t reg, uint16_t value);
+	String identification(uint8_t address, uint8_t id);
+	uint64_t write_count(uint8_t address) const;
+	void direct(uint8_t address, uint8_t function, uint16_t reg, uint16_t count, Array<uint16_t>& registers, Array<bool>& bits);
+};
+
+#endif /* I_BUS */
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "compress.h"
+
+Compressor::Compressor()
+{
+#ifdef WITH_ZSTD
+	cctx = NULL;
+	cdict = NULL;
+#endif
+	active = false;
+	level = 3;
+	dict_pending = false;
+}
+
+Compressor::~Compressor()
+{
+#ifdef WITH_ZSTD
+	if (cdict != NULL) {
+		ZSTD_freeCDict(cdict);
+	}
+	if (cctx != NULL) {
+		ZSTD_freeCCtx(cctx);
+	}
+#endif
+}
+
+void
+Compressor::setup(int level, const String& file)
+{
+#ifdef WITH_ZSTD
+	this->level = level;
+	this->file = file;
+	cctx = ZSTD_createCCtx();
+	if (cctx == NULL) {
+		throw Error("failed to create zstd context");
+	}
+	// consumers with an outdated dictionary get an error instead of garbage
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+	active = true;
+	load();
+#else
+	throw Error("built without zstd support");
+#endif
+}
+
+bool
+Compressor::enabled() const
+{
+	return active;
+}
+
+bool
+Compressor::has_dictionary() const
+{
+	return !dict.empty();
+}
+
+const std::string&
+Compressor::dictionary() const
+{
+	return dict;
+}
+
+const String&
+Compressor::dictionary_id() const
+{
+	return dict_id;
+}
+
+bool
+Compressor::dictionary_pending() const
+{
+	// set until the dictionary went out to the broker once
+	return dict_pending;
+}
+
+void
+Compressor::dictionary_published()
+{
+	dict_pending = false;
+}
+
+static std::string
+file_part(const String& name)
+{
+	// product names may contain slashes
+	std::string ret(name.c_str());
+	for (size_t i = 0; i < ret.length(); i++) {
+		if (ret[i] == '/') {
+			ret[i] = '_';
+		}
+	}
+	return ret;
+}
+
+String
+Compressor::dictionary_name(const String& vendor, const String& product)
+{
+	std::string name = file_part(vendor) + "/" + file_part(product) + ".zdict";
+	return String(name.data(), name.length());
+}
+
+bool
+Compressor::read_file(const String& file, std::string& data)
+{
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	char buf[4096];
+	ssize_t rc;
+	while ((rc = read(fd, buf, sizeof(buf))) > 0) {
+		data.append(buf, rc);
+	}
+	close(fd);
+	if (rc < 0 || data.empty()) {
+		syslog(LOG_ERR, "failed to read zstd dictionary %s", file.c_str());
+		return false;
+	}
+	return true;
+}
+
+void
+Compressor::load()
+{
+	std::string data;
+	if (read_file(file, data)) {
+		use_dictionary(data.data(), data.length());
+	}
+}
+
+bool
+Compressor::load_dictionary(const String& file)
+{
+	std::string data;
+	if (!read_file(file, data)) {
+		return false;
+	}
+	set_dictionary(data.data(), data.length());
+	return true;
+}
+
+void
+Compressor::save()
+{
+	String tmpfile = file + ".tmp";
+	int fd = open(tmpfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0) {
+		syslog(LOG_ERR, "failed to write zstd dictionary %s", tmpfile.c_str());
+		return;
+	}
+	bool ok = (write(fd, dict.data(), dict.length()) == (ssize_t)dict.length());
+	close(fd);
+	if (!ok || rename(tmpfile.c_str(), file.c_str()) < 0) {
+		syslog(LOG_ERR, "failed to write zstd dictionary %s", file.c_str());
+		unlink(tmpfile.c_str());
+	}
+}
+
+void
+Compressor::use_dictionary(const void *data, size_t len)
+{
+#ifdef WITH_ZSTD
+	dict.assign((const char*)data, len);
+	// FNV-1a of the content, frames are published under it
+	uint32_t hash = 0x811c9dc5;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (uint8_t)dict[i];
+		hash *= 0x01000193;
+	}
+	dict_id.printf("%08x", hash);
+	dict_pending = true;
+	if (cdict != NULL) {
+		ZSTD_freeCDict(cdict);
+	}
+	cdict = ZSTD_createCDict(dict.data(), dict.length(), level);
+	if (cdict == NULL) {
+		throw Error("failed to create zstd dictionary");
+	}
+	ZSTD_CCtx_refCDict(cctx, cdict);
+#endif
+}
+
+void
+Compressor::set_dictionary(const void *data, size_t len)
+{
+	use_dictionary(data, len);
+	if (!file.empty()) {
+		save();
+	}
+}
+
+const std::string&
+Compressor::compress(const void *data, size_t len)
+{
+#ifdef WITH_ZSTD
+	out.resize(ZSTD_compressBound(len));
+	size_t rc = ZSTD_compress2(cctx, &out[0], out.size(), data, len);
+	if (ZSTD_isError(rc)) {
+		throw Error(S + "zstd compression failed: " + ZSTD_getErrorName(rc));
+	}
+	out.resize(rc);
+#endif
+	return out;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_COMPRESS
+#define I_COMPRESS
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <string>
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// zstd compression of the payloads of one device with a raw content
+// dictionary: the one built for its handler by bench/zdict_gen from the
+// key set of a synthetic poll, otherwise the first payload ever
+// compressed; it is kept in a file, so consumers don't need a new one
+// after every restart
+class Compressor : public Base {
+private:
+#ifdef WITH_ZSTD
+	ZSTD_CCtx *cctx;
+	ZSTD_CDict *cdict;
+#endif
+	bool active;
+	int level;
+	String file;
+	std::string dict;
+	String dict_id;
+	bool dict_pending;
+	std::string out;
+
+	static bool read_file(const String& file, std::string& data);
+	void use_dictionary(const void *data, size_t len);
+	void load();
+	void save();
+
+public:
+	Compressor();
+	~Compressor();
+	void setup(int level, const String& file);
+	bool enabled() const;
+	bool has_dictionary() const;
+	const std::string& dictionary() const;
+	const String& dictionary_id() const;
+	bool dictionary_pending() const;
+	void dictionary_published();
+	void set_dictionary(const void *data, size_t len);
+	bool load_dictionary(const String& file);
+	static String dictionary_name(const String& vendor, const String& product);
+	const std::string& compress(const void *data, size_t len);
+};
+
+#endif /* I_COMPRESS */
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "counter.h"
+
+#define COUNTER_MAGIC 0x6d62636e
+#define COUNTER_VERSION 2
+
+// state file: magic, version, entry size and number of devices, then
+// per device its key prefix and entries; anything else is not loaded
+
+CounterTracker::Group::Group()
+{
+	dirty = false;
+}
+
+CounterTracker::Group*
+CounterTracker::group(const String& prefix)
+{
+	mtx.lock();
+	if (!groups.exists(prefix)) {
+		groups[prefix] = new Group;
+		prefixes << prefix;
+	}
+	Group *ret = groups[prefix];
+	mtx.unlock();
+	return ret;
+}
+
+static bool
+read_string(int fd, String& out)
+{
+	uint16_t len;
+	char buf[UINT16_MAX + 1];
+	if (read(fd, &len, sizeof(len)) != sizeof(len) || read(fd, buf, len) != len) {
+		return false;
+	}
+	buf[len] = '\0';
+	out = buf;
+	return true;
+}
+
+static bool
+write_string(int fd, const String& str)
+{
+	uint16_t len = str.length();
+	return (write(fd, &len, sizeof(len)) == sizeof(len) && write(fd, str.c_str(), len) == len);
+}
+
+void
+CounterTracker::load(const String& file)
+{
+	statefile = file;
+
+	int fd = ::open(file.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	uint32_t head[4];
+	if (read(fd, head, sizeof(head)) != sizeof(head) || head[0] != COUNTER_MAGIC ||
+	    head[1] != COUNTER_VERSION || head[2] != sizeof(Entry)) {
+		syslog(LOG_WARNING, "ignoring counter state %s of another format", file.c_str());
+		::close(fd);
+		return;
+	}
+	bool ok = true;
+	for (uint32_t g = 0; g < head[3] && ok; g++) {
+		String prefix;
+		uint32_t count;
+		if (!read_string(fd, prefix) || read(fd, &count, sizeof(count)) != sizeof(count)) {
+			break;
+		}
+		Group *grp = group(prefix);
+		for (uint32_t i = 0; i < count; i++) {
+			String key;
+			Entry entry;
+			if (!read_string(fd, key) || read(fd, &entry, sizeof(entry)) != sizeof(entry)) {
+				ok = false;
+				break;
+			}
+			int64_t pos = grp->slot(key);
+			grp->mtx.lock();
+			grp->entries[pos] = entry;
+			grp->mtx.unlock();
+		}
+	}
+	::close(fd);
+}
+
+void
+CounterTracker::save()
+{
+	mtx.lock();
+	bool dirty = false;
+	for (int64_t g = 0; g <= prefixes.max; g++) {
+		Group *grp = groups[prefixes[g]];
+		grp->mtx.lock();
+		dirty = dirty || grp->dirty;
+		grp->mtx.unlock();
+	}
+	if (!dirty || statefile.empty()) {
+		mtx.unlock();
+		return;
+	}
+	// write a new file and rename it, so a crash never leaves a partial state
+	String tmpfile = statefile + ".tmp";
+	int fd = ::open(tmpfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		mtx.unlock();
+		return;
+	}
+	bool ok = true;
+	uint32_t head[4] = {COUNTER_MAGIC, COUNTER_VERSION, (uint32_t)sizeof(Entry), (uint32_t)(prefixes.max + 1)};
+	ok = ok && write(fd, head, sizeof(head)) == sizeof(head);
+	for (int64_t g = 0; g <= prefixes.max && ok; g++) {
+		Group *grp = groups[prefixes[g]];
+		grp->mtx.lock();
+		uint32_t count = grp->keys.max + 1;
+		ok = ok && write_string(fd, prefixes[g]);
+		ok = ok && write(fd, &count, sizeof(count)) == sizeof(count);
+		for (int64_t i = 0; i <= grp->keys.max && ok; i++) {
+			ok = ok && write_string(fd, grp->keys[i]);
+			ok = ok && write(fd, &grp->entries[i], sizeof(Entry)) == sizeof(Entry);
+		}
+		grp->dirty = false;
+		grp->mtx.unlock();
+	}
+	::close(fd);
+	if (!ok || rename(tmpfile.c_str(), statefile.c_str()) != 0) {
+		// try again with the next save
+		for (int64_t g = 0; g <= prefixes.max; g++) {
+			Group *grp = groups[prefixes[g]];
+			grp->mtx.lock();
+			grp->dirty = true;
+			grp->mtx.unlock();
+		}
+	}
+	mtx.unlock();
+}
+
+int64_t
+CounterTracker::Group::slot(const String& key)
+{
+	mtx.lock();
+	if (!index.exists(key)) {
+		int64_t pos = keys.max + 1;
+		keys[pos] = key;
+		index[key] = pos;
+		Entry& entry = entries[pos];
+		memset(&entry, 0, sizeof(entry));
+	}
+	int64_t ret = index[key];
+	mtx.unlock();
+	return ret;
+}
+
+void
+CounterTracker::Group::update(int64_t slot, uint64_t raw, int bits, double now, uint64_t& total, double& rate)
+{
+	mtx.lock();
+	Entry& entry = entries[slot];
+	if (!entry.valid) {
+		entry.total = raw;
+		entry.rate = 0;
+		entry.valid = 1;
+	} else {
+		uint64_t delta;
+		if (raw >= entry.raw) {
+			delta = raw - entry.raw;
+		} else {
+			uint64_t range = (bits >= 64) ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+			uint64_t wrapdelta = (range - entry.raw) + raw + 1;
+			if (bits < 64 && wrapdelta <= range / 2) {
+				// counter wrapped
+				delta = wrapdelta;
+			} else {
+				// device restarted and counts from zero again
+				delta = raw;
+				entry.restarts++;
+			}
+		}
+		entry.total += delta;
+		if (now > entry.time) {
+			entry.rate = (double)delta / (now - entry.time);
+		}
+	}
+	entry.raw = raw;
+	entry.time = now;
+	total = entry.total;
+	rate = entry.rate;
+	dirty = true;
+	mtx.unlock();
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_COUNTER
+#define I_COUNTER
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+
+class CounterTracker : public Base {
+public:
+	struct Spec {
+		String field;
+		int64_t first;		// first array index, -1 for a plain value
+		int64_t count;
+		int bits;
+	};
+private:
+	struct Entry {
+		uint64_t raw;
+		uint64_t total;
+		double time;
+		double rate;
+		uint32_t restarts;
+		uint8_t valid;
+	};
+public:
+	// the counters of one device, with a lock of their own, so bus
+	// threads don't wait for each other
+	class Group : public Base {
+	private:
+		friend class CounterTracker;
+		AArray<int64_t> index;
+		Array<String> keys;
+		Array<Entry> entries;
+		Mutex mtx;
+		bool dirty;
+
+	public:
+		Group();
+		int64_t slot(const String& key);
+		void update(int64_t slot, uint64_t raw, int bits, double now, uint64_t& total, double& rate);
+	};
+private:
+	AArray<Group*> groups;
+	Array<String> prefixes;
+	Mutex mtx;
+	String statefile;
+
+public:
+	void load(const String& file);
+	void save();
+	Group* group(const String& prefix);
+};
+
+#endif /* I_COUNTER */
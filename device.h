@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_DEVICE
+#define I_DEVICE
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include "mqtt.h"
+#include "encoder.h"
+#include "aggregate.h"
+#include "counter.h"
+#include "bus.h"
+#include "compress.h"
+#include "history.h"
+
+struct Device;
+
+typedef void (*devfunction)(Bus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, Device& dev, JSON& dev_cfg);
+
+// the handlers by vendor and product, as reported by identification
+void register_handlers(AArray<AArray<devfunction>>& devfunctions);
+
+// per device state, resolved once, so polling needs no string lookups
+struct Device {
+	JSON *cfg;
+	uint8_t address;
+	int qos;
+	double interval;
+	String maintopic;
+	String data_topic;
+	String status_topic;
+	String schema_topic;
+	String cmd_topic;
+	String zstd_topic;
+	String dict_topic;
+	String history_topic;
+	CounterTracker::Group *counters;
+	uint64_t poolkey;
+	// poll and publish allocate from the arena of the thread
+	bool arena;
+	int priority;
+	bool write_cache;
+	double write_cache_verify;
+
+	bool identified;
+	String vendor;
+	String product;
+	String version;
+	uint32_t major;
+	uint32_t minor;
+	devfunction handler;
+
+	MQTT mqtt;
+	Encoder encoder;
+	Compressor compressor;
+	Aggregator aggregator;
+	History history;
+	Array<CounterTracker::Spec> counterspecs;
+	Array<int64_t> counterslots;
+	bool track_counters;
+	struct timespec lasttime;
+};
+
+#endif /* I_DEVICE */
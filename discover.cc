@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "discover.h"
+#include <atomic>
+#include <dirent.h>
+
+#define SCAN_FIRST 1
+#define SCAN_LAST 247
+
+struct ScanResult {
+	bool found;
+	String vendor;
+	String product;
+	String version;
+};
+
+struct Scan {
+	String host;
+	String port;
+	bool ignore_sequence;
+	double probe_timeout;
+	std::atomic<int> next;
+	ScanResult results[SCAN_LAST + 1];
+};
+
+static void*
+ScanLoop(void *arg)
+{
+	Scan *scan = (Scan*)arg;
+
+	// every probe thread has its own connection to the gateway
+	Bus mb(scan->host, scan->port);
+	mb.set_ignore_sequence(scan->ignore_sequence);
+	mb.set_retries(0);
+	// most addresses are empty, don't wait the full budget for each
+	mb.set_budget(scan->probe_timeout, scan->probe_timeout);
+
+	for (;;) {
+		int address = scan->next++;
+		if (address > SCAN_LAST) {
+			break;
+		}
+		ScanResult& result = scan->results[address];
+		try {
+			result.vendor = mb.identification(address, 0);
+			result.product = mb.identification(address, 1);
+			result.version = mb.identification(address, 2);
+			result.found = true;
+		} catch (...) {
+		}
+	}
+	return NULL;
+}
+
+static void
+load_catalog(const String& dir, AArray<AArray<bool>>& catalog)
+{
+	DIR *d = opendir(dir.c_str());
+	if (d == NULL) {
+		return;
+	}
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.') {
+			continue;
+		}
+		String path = dir + "/" + de->d_name;
+		struct stat sb;
+		if (stat(path.c_str(), &sb) < 0) {
+			continue;
+		}
+		if (S_ISDIR(sb.st_mode)) {
+			load_catalog(path, catalog);
+			continue;
+		}
+		try {
+			File f;
+			f.open(path, O_RDONLY);
+			String data(f);
+			JSON info;
+			info.parse(data);
+			String vendor = info["vendor"];
+			String device = info["device"];
+			catalog[vendor][device] = true;
+		} catch (...) {
+		}
+	}
+	closedir(d);
+}
+
+void
+discover(JSON& cfg, AArray<AArray<devfunction>>& devfunctions, const String& infodir, const String& outfile, int concurrency)
+{
+	AArray<AArray<bool>> catalog;
+	load_catalog(infodir, catalog);
+
+	if (concurrency < 1) {
+		concurrency = 1;
+	}
+
+	String maintopic = "mb_mqttbridge";
+	if (cfg.exists("mqtt") && cfg["mqtt"].exists("maintopic")) {
+		String tmp = cfg["mqtt"]["maintopic"];
+		maintopic = tmp;
+	}
+	JSON& modbuses = cfg["modbuses"];
+	for (int64_t bus = 0; bus <= modbuses.get_array().max; bus++) {
+		JSON& bus_cfg = modbuses[bus];
+		a_ptr<Scan> scan;
+		scan = new Scan;
+		String host = bus_cfg["host"];
+		String port = bus_cfg["port"];
+		scan->host = host;
+		scan->port = port;
+		scan->ignore_sequence = false;
+		if (bus_cfg.exists("ignore_sequence")) {
+			scan->ignore_sequence = bus_cfg["ignore_sequence"];
+		}
+		scan->probe_timeout = 0.3;
+		if (bus_cfg.exists("probe_timeout")) {
+			scan->probe_timeout = bus_cfg["probe_timeout"].get_numstr().getd();
+		}
+		scan->next = SCAN_FIRST;
+		for (int i = 0; i <= SCAN_LAST; i++) {
+			scan->results[i].found = false;
+		}
+
+		printf("scanning %s:%s\n", host.c_str(), port.c_str());
+		Array<pthread_t> threads;
+		for (int i = 0; i < concurrency; i++) {
+			pthread_create(&threads[i], NULL, ScanLoop, scan.get());
+		}
+		for (int i = 0; i < concurrency; i++) {
+			pthread_join(threads[i], NULL);
+		}
+
+		Array<JSON> devices;
+		Array<JSON> unsupported;
+		for (int address = SCAN_FIRST; address <= SCAN_LAST; address++) {
+			ScanResult& result = scan->results[address];
+			if (!result.found) {
+				continue;
+			}
+			bool supported = devfunctions.exists(result.vendor) && devfunctions[result.vendor].exists(result.product);
+			bool cataloged = catalog.exists(result.vendor) && catalog[result.vendor].exists(result.product);
+			printf("  %3d: %s %s %s%s%s\n", address, result.vendor.c_str(), result.product.c_str(), result.version.c_str(),
+			    supported ? "" : " (no handler)", cataloged ? "" : " (not in catalog)");
+
+			AArray<JSON> device;
+			device["address"].set_number(S + address);
+			device["maintopic"] = S + maintopic + "/" + host + "/" + address;
+			device["vendor"] = result.vendor;
+			device["product"] = result.product;
+			// kept out of devices, they would only fail on every poll
+			if (supported) {
+				devices[devices.max + 1] = device;
+			} else {
+				unsupported[unsupported.max + 1] = device;
+			}
+		}
+		bus_cfg["devices"] = devices;
+		if (unsupported.max >= 0) {
+			bus_cfg["unsupported_devices"] = unsupported;
+		}
+	}
+
+	File f;
+	f.open(outfile, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	f.write(cfg.generate() + "\n");
+	f.close();
+	printf("suggested config written to %s\n", outfile.c_str());
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "encoder.h"
+
+// CBOR major types
+#define CBOR_UINT	0
+#define CBOR_NEGINT	1
+#define CBOR_TEXT	3
+#define CBOR_ARRAY	4
+#define CBOR_MAP	5
+#define CBOR_SIMPLE	7
+
+Encoder::Encoder()
+{
+	format = FORMAT_JSON;
+	schema_changed = false;
+}
+
+void
+Encoder::set_format(const String& name)
+{
+	if (name == "cbor") {
+		format = FORMAT_CBOR;
+	} else if (name == "msgpack") {
+		format = FORMAT_MSGPACK;
+	} else if (name == "json") {
+		format = FORMAT_JSON;
+	} else {
+		throw Error(S + "unknown encoding " + name);
+	}
+	schema_changed = binary();
+}
+
+Encoder::Format
+Encoder::get_format() const
+{
+	return format;
+}
+
+bool
+Encoder::binary() const
+{
+	return (format != FORMAT_JSON);
+}
+
+uint64_t
+Encoder::key_id(const String& key)
+{
+	if (!ids.exists(key)) {
+		uint64_t id = keys.max + 1;
+		ids[key] = id;
+		keys[id] = key;
+		schema_changed = true;
+	}
+	return ids[key];
+}
+
+void
+Encoder::put_byte(uint8_t val)
+{
+	buf.push_back((char)val);
+}
+
+void
+Encoder::put_be(uint64_t val, int bytes)
+{
+	for (int i = bytes - 1; i >= 0; i--) {
+		put_byte((val >> (i * 8)) & 0xff);
+	}
+}
+
+void
+Encoder::put_head(uint8_t type, uint64_t len)
+{
+	if (format == FORMAT_CBOR) {
+		uint8_t major = type << 5;
+		if (len < 24) {
+			put_byte(major | len);
+		} else if (len <= UINT8_MAX) {
+			put_byte(major | 24);
+			put_be(len, 1);
+		} else if (len <= UINT16_MAX) {
+			put_byte(major | 25);
+			put_be(len, 2);
+		} else if (len <= UINT32_MAX) {
+			put_byte(major | 26);
+			put_be(len, 4);
+		} else {
+			put_byte(major | 27);
+			put_be(len, 8);
+		}
+		return;
+	}
+
+	switch (type) {
+	case CBOR_UINT:
+		if (len < 128) {
+			put_byte(len);
+		} else if (len <= UINT8_MAX) {
+			put_byte(0xcc);
+			put_be(len, 1);
+		} else if (len <= UINT16_MAX) {
+			put_byte(0xcd);
+			put_be(len, 2);
+		} else if (len <= UINT32_MAX) {
+			put_byte(0xce);
+			put_be(len, 4);
+		} else {
+			put_byte(0xcf);
+			put_be(len, 8);
+		}
+		break;
+	case CBOR_TEXT:
+		if (len < 32) {
+			put_byte(0xa0 | len);
+		} else if (len <= UINT8_MAX) {
+			put_byte(0xd9);
+			put_be(len, 1);
+		} else if (len <= UINT16_MAX) {
+			put_byte(0xda);
+			put_be(len, 2);
+		} else {
+			put_byte(0xdb);
+			put_be(len, 4);
+		}
+		break;
+	case CBOR_ARRAY:
+		if (len < 16) {
+			put_byte(0x90 | len);
+		} else if (len <= UINT16_MAX) {
+			put_byte(0xdc);
+			put_be(len, 2);
+		} else {
+			put_byte(0xdd);
+			put_be(len, 4);
+		}
+		break;
+	case CBOR_MAP:
+		if (len < 16) {
+			put_byte(0x80 | len);
+		} else if (len <= UINT16_MAX) {
+			put_byte(0xde);
+			put_be(len, 2);
+		} else {
+			put_byte(0xdf);
+			put_be(len, 4);
+		}
+		break;
+	}
+}
+
+void
+Encoder::put_int(int64_t val)
+{
+	if (val >= 0) {
+		put_head(CBOR_UINT, val);
+		return;
+	}
+	if (format == FORMAT_CBOR) {
+		put_head(CBOR_NEGINT, (uint64_t)(-(val + 1)));
+		return;
+	}
+	if (val >= -32) {
+		put_byte(0xe0 | (val & 0x1f));
+	} else if (val >= INT8_MIN) {
+		put_byte(0xd0);
+		put_be((uint64_t)val, 1);
+	} else if (val >= INT16_MIN) {
+		put_byte(0xd1);
+		put_be((uint64_t)val, 2);
+	} else if (val >= INT32_MIN) {
+		put_byte(0xd2);
+		put_be((uint64_t)val, 4);
+	} else {
+		put_byte(0xd3);
+		put_be((uint64_t)val, 8);
+	}
+}
+
+void
+Encoder::put_float(float val)
+{
+	union {
+		float f;
+		uint32_t i;
+	};
+	f = val;
+	put_byte((format == FORMAT_CBOR) ? (CBOR_SIMPLE << 5 | 26) : 0xca);
+	put_be(i, 4);
+}
+
+void
+Encoder::put_double(double val)
+{
+	union {
+		double d;
+		uint64_t i;
+	};
+	d = val;
+	put_byte((format == FORMAT_CBOR) ? (CBOR_SIMPLE << 5 | 27) : 0xcb);
+	put_be(i, 8);
+}
+
+void
+Encoder::put_number(const String& numstr)
+{
+	const char *str = numstr.c_str();
+	int digits = 0;
+	bool integer = true;
+
+	for (const char *pos = str; *pos != '\0'; pos++) {
+		if (*pos >= '0' && *pos <= '9') {
+			if (digits > 0 || *pos != '0') {
+				digits++;
+			}
+		} else if (*pos != '-') {
+			integer = false;
+		}
+	}
+	if (integer) {
+		// 64 bit counters don't fit into a double without loss
+		errno = 0;
+		if (*str == '-') {
+			int64_t val = strtoll(str, NULL, 10);
+			if (errno == 0) {
+				put_int(val);
+				return;
+			}
+		} else {
+			uint64_t val = strtoull(str, NULL, 10);
+			if (errno == 0) {
+				put_head(CBOR_UINT, val);
+				return;
+			}
+		}
+	}
+	// the handlers format with a fixed number of digits, up to 7
+	// significant digits survive the round trip through a float
+	double val = strtod(str, NULL);
+	if (integer || digits > 7) {
+		put_double(val);
+	} else {
+		put_float(val);
+	}
+}
+
+void
+Encoder::put_string(const String& val)
+{
+	put_head(CBOR_TEXT, val.length());
+	buf.append(val.c_str(), val.length());
+}
+
+void
+Encoder::put_bool(bool val)
+{
+	if (format == FORMAT_CBOR) {
+		put_byte(CBOR_SIMPLE << 5 | (val ? 21 : 20));
+	} else {
+		put_byte(val ? 0xc3 : 0xc2);
+	}
+}
+
+void
+Encoder::put_null()
+{
+	put_byte((format == FORMAT_CBOR) ? (CBOR_SIMPLE << 5 | 22) : 0xc0);
+}
+
+void
+Encoder::put_element(const JSON& element)
+{
+	if (element.is_object()) {
+		const AArray<JSON>& object = element.get_object();
+		Array<String> objkeys = object.getkeys();
+		put_head(CBOR_MAP, objkeys.max + 1);
+		for (int64_t i = 0; i <= objkeys.max; i++) {
+			put_head(CBOR_UINT, key_id(objkeys[i]));
+			put_element(object[objkeys[i]]);
+		}
+	} else if (element.is_array()) {
+		const Array<JSON>& array = element.get_array();
+		put_head(CBOR_ARRAY, array.max + 1);
+		for (int64_t i = 0; i <= array.max; i++) {
+			put_element(array[i]);
+		}
+	} else if (element.is_number()) {
+		put_number(element.get_numstr());
+	} else if (element.is_boolean()) {
+		bool val = element;
+		put_bool(val);
+	} else if (element.is_string()) {
+		String val = element;
+		put_string(val);
+	} else {
+		put_null();
+	}
+}
+
+const std::string&
+Encoder::encode(const JSON& doc)
+{
+	buf.clear();
+	if (format == FORMAT_JSON) {
+		String tmp = doc.generate();
+		buf.assign(tmp.c_str(), tmp.length());
+	} else {
+		put_element(doc);
+	}
+	return buf;
+}
+
+bool
+Encoder::schema_pending() const
+{
+	return schema_changed;
+}
+
+String
+Encoder::schema()
+{
+	JSON schema;
+	{
+		AArray<JSON> tmp;
+		schema = tmp;
+	}
+	schema["encoding"] = String((format == FORMAT_CBOR) ? "cbor" : "msgpack");
+	Array<JSON> names;
+	for (int64_t i = 0; i <= keys.max; i++) {
+		names[i] = keys[i];
+	}
+	schema["keys"] = names;
+	schema_changed = false;
+	return schema.generate();
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_ENCODER
+#define I_ENCODER
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <string>
+
+class Encoder : public Base {
+public:
+	enum Format {
+		FORMAT_JSON,
+		FORMAT_CBOR,
+		FORMAT_MSGPACK
+	};
+private:
+	Format format;
+	AArray<uint64_t> ids;
+	Array<String> keys;
+	bool schema_changed;
+	std::string buf;
+
+	uint64_t key_id(const String& key);
+	void put_byte(uint8_t val);
+	void put_be(uint64_t val, int bytes);
+	void put_head(uint8_t type, uint64_t len);
+	void put_int(int64_t val);
+	void put_double(double val);
+	void put_float(float val);
+	void put_number(const String& numstr);
+	void put_string(const String& val);
+	void put_bool(bool val);
+	void put_null();
+	void put_element(const JSON& element);
+
+public:
+	Encoder();
+	void set_format(const String& name);
+	Format get_format() const;
+	bool binary() const;
+	const std::string& encode(const JSON& doc);
+	bool schema_pending() const;
+	String schema();
+};
+
+#endif /* I_ENCODER */
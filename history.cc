@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "history.h"
+#include <sys/mman.h>
+#include <math.h>
+
+#define HISTORY_MAGIC 0x6d626873
+#define HISTORY_VERSION 1
+
+History::History()
+{
+	samples = 0;
+	resolution = 0.001;
+	fd = -1;
+	mapsize = 0;
+	map = NULL;
+	hdr = NULL;
+	fields = NULL;
+	ring = NULL;
+}
+
+History::~History()
+{
+	if (map != NULL) {
+		msync(map, mapsize, MS_SYNC);
+		munmap(map, mapsize);
+	}
+	if (fd >= 0) {
+		::close(fd);
+	}
+}
+
+void
+History::setup(JSON& hist_cfg, const String& file)
+{
+	// {"fields": ["power", ...], "samples": 600, "resolution": 0.001}
+	samples = 600;
+	if (hist_cfg.exists("samples")) {
+		samples = hist_cfg["samples"].get_numstr().getll();
+	}
+	if (hist_cfg.exists("resolution")) {
+		String tmp = hist_cfg["resolution"].get_numstr();
+		resolution = tmp.getd();
+	}
+	if (samples < 2 || resolution <= 0) {
+		throw Error(S + "invalid history size for " + file);
+	}
+	Array<JSON>& field_cfg = hist_cfg["fields"].get_array();
+	for (int64_t i = 0; i <= field_cfg.max; i++) {
+		String name = field_cfg[i];
+		if (name.length() >= sizeof(FieldHeader::name)) {
+			throw Error(S + "history field name " + name + " too long");
+		}
+		names[i] = name;
+	}
+	if (names.max < 0) {
+		return;
+	}
+
+	uint32_t nfields = names.max + 1;
+	fd = ::open(file.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		throw Error(S + "failed to open history " + file + ": " + strerror(errno));
+	}
+	mapsize = sizeof(Header) + nfields * sizeof(FieldHeader) + (uint64_t)nfields * samples * sizeof(Sample);
+	if (ftruncate(fd, mapsize) < 0) {
+		throw Error(S + "failed to size history " + file + ": " + strerror(errno));
+	}
+	void *addr = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		throw Error(S + "failed to map history " + file + ": " + strerror(errno));
+	}
+	map = (uint8_t*)addr;
+	hdr = (Header*)map;
+	fields = (FieldHeader*)(map + sizeof(Header));
+	ring = (Sample*)(map + sizeof(Header) + nfields * sizeof(FieldHeader));
+
+	// keep the history across restarts, unless the layout changed
+	bool valid = (hdr->magic == HISTORY_MAGIC && hdr->version == HISTORY_VERSION &&
+	    hdr->nfields == nfields && hdr->samples == samples && hdr->resolution == resolution);
+	for (uint32_t i = 0; valid && i < nfields; i++) {
+		FieldHeader& fh = fields[i];
+		valid = (strncmp(fh.name, names[i].c_str(), sizeof(fh.name)) == 0 &&
+		    fh.head < samples && fh.count <= samples);
+	}
+	if (!valid) {
+		hdr->magic = HISTORY_MAGIC;
+		hdr->version = HISTORY_VERSION;
+		hdr->nfields = nfields;
+		hdr->samples = samples;
+		hdr->resolution = resolution;
+		for (uint32_t i = 0; i < nfields; i++) {
+			FieldHeader& fh = fields[i];
+			memset(&fh, 0, sizeof(fh));
+			strncpy(fh.name, names[i].c_str(), sizeof(fh.name) - 1);
+		}
+	}
+}
+
+bool
+History::enabled() const
+{
+	return (map != NULL);
+}
+
+void
+History::append(int64_t field, int64_t time, int64_t value)
+{
+	FieldHeader& fh = fields[field];
+	Sample *fring = ring + (uint64_t)field * samples;
+
+	if (fh.count == 0) {
+		fh.base_time = time;
+		fh.base_value = value;
+		fh.last_time = time;
+		fh.last_value = value;
+		fh.head = 0;
+		fring[0].dt = 0;
+		fring[0].delta = 0;
+		fh.count = 1;
+		return;
+	}
+	if (time <= fh.last_time) {
+		return;
+	}
+	if (fh.count == samples) {
+		// the second oldest sample becomes the new base
+		fh.head = (fh.head + 1) % samples;
+		fh.base_time += fring[fh.head].dt;
+		fh.base_value += fring[fh.head].delta;
+		fh.count--;
+	}
+
+	// deltas are taken against the reconstructed value, so a clamped
+	// jump is corrected by the following samples
+	int64_t dt = time - fh.last_time;
+	int64_t delta = value - fh.last_value;
+	if (dt > UINT32_MAX) {
+		dt = UINT32_MAX;
+	}
+	if (delta > INT32_MAX) {
+		delta = INT32_MAX;
+	} else if (delta < INT32_MIN) {
+		delta = INT32_MIN;
+	}
+	Sample& sample = fring[(fh.head + fh.count) % samples];
+	sample.dt = dt;
+	sample.delta = delta;
+	fh.last_time += dt;
+	fh.last_value += delta;
+	fh.count++;
+}
+
+void
+History::update(JSON& data, const struct timespec& now)
+{
+	if (map == NULL) {
+		return;
+	}
+	int64_t time = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	for (int64_t i = 0; i <= names.max; i++) {
+		if (!data.exists(names[i]) || !data[names[i]].is_number()) {
+			continue;
+		}
+		double val = data[names[i]].get_numstr().getd();
+		append(i, time, llround(val / resolution));
+	}
+}
+
+void
+History::stream(int64_t field, int64_t from, int64_t to, std::string& out)
+{
+	const FieldHeader& fh = fields[field];
+	const Sample *fring = ring + (uint64_t)field * samples;
+	char buf[64];
+
+	int64_t time = fh.base_time;
+	int64_t value = fh.base_value;
+	bool first = true;
+	for (uint64_t k = 0; k < fh.count; k++) {
+		if (k > 0) {
+			const Sample& sample = fring[(fh.head + k) % samples];
+			time += sample.dt;
+			value += sample.delta;
+		}
+		if (time < from) {
+			continue;
+		}
+		if (time > to) {
+			break;
+		}
+		// split the magnitude, so times before 1970 don't get negative millis
+		uint64_t abs_ms = (time < 0) ? -(uint64_t)time : (uint64_t)time;
+		int len = snprintf(buf, sizeof(buf), "%s[%s%llu.%03llu,%.15g]", first ? "" : ",",
+		    (time < 0) ? "-" : "", (unsigned long long)(abs_ms / 1000), (unsigned long long)(abs_ms % 1000),
+		    value * resolution);
+		out.append(buf, len);
+		first = false;
+	}
+}
+
+static void
+append_string(std::string& out, const String& str)
+{
+	// field names come from the config, quote them like any other JSON string
+	out.append("\"");
+	for (size_t i = 0; i < str.length(); i++) {
+		unsigned char c = str.c_str()[i];
+		if (c == '"' || c == '\\') {
+			out.append("\\");
+			out.append(1, c);
+		} else if (c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out.append(buf);
+		} else {
+			out.append(1, c);
+		}
+	}
+	out.append("\"");
+}
+
+static const char *
+request_time(JSON& req, const char *key, int64_t& ms)
+{
+	if (!req.exists(key)) {
+		return NULL;
+	}
+	if (!req[key].is_number()) {
+		return "from and to must be numbers";
+	}
+	String tmp = req[key].get_numstr();
+	double value = tmp.getd();
+	// keep the conversion to milliseconds inside int64_t
+	if (!(value > -1e15 && value < 1e15)) {
+		return "from and to out of range";
+	}
+	ms = value * 1000;
+	return NULL;
+}
+
+const char *
+History::answer(JSON& req, const String& maintopic, String& topic, std::string& out)
+{
+	if (!req.is_object()) {
+		return "request must be an object";
+	}
+	struct timespec tp;
+	clock_gettime(CLOCK_REALTIME, &tp);
+	int64_t to = (int64_t)tp.tv_sec * 1000 + tp.tv_nsec / 1000000;
+	int64_t from = to - 600 * 1000;
+	const char *error;
+	if ((error = request_time(req, "from", from)) != NULL) {
+		return error;
+	}
+	if ((error = request_time(req, "to", to)) != NULL) {
+		return error;
+	}
+	if (req.exists("response_topic")) {
+		if (!req["response_topic"].is_string()) {
+			return "response_topic must be a string";
+		}
+		String tmp = req["response_topic"];
+		// answers must not land on the request topic or on data of the device
+		String prefix = maintopic + "/";
+		if (tmp.length() == 0 || strpbrk(tmp.c_str(), "+#") != NULL ||
+		    tmp == maintopic ||
+		    (tmp.length() >= prefix.length() && strncmp(tmp.c_str(), prefix.c_str(), prefix.length()) == 0)) {
+			syslog(LOG_WARNING, "%s: history response topic %s not allowed", maintopic.c_str(), tmp.c_str());
+			return "response_topic not allowed";
+		}
+		topic = tmp;
+	}
+	AArray<bool> wanted;
+	bool all = true;
+	if (req.exists("fields")) {
+		if (!req["fields"].is_array()) {
+			return "fields must be an array";
+		}
+		Array<JSON>& req_fields = req["fields"].get_array();
+		for (int64_t i = 0; i <= req_fields.max; i++) {
+			if (!req_fields[i].is_string()) {
+				return "fields must be strings";
+			}
+			String name = req_fields[i];
+			wanted[name] = true;
+		}
+		all = false;
+	}
+
+	// the response is written straight from the ring, without a DOM
+	out.append("\"fields\":{");
+	bool first = true;
+	for (int64_t i = 0; i <= names.max; i++) {
+		if (!all && !wanted.exists(names[i])) {
+			continue;
+		}
+		if (!first) {
+			out.append(",");
+		}
+		append_string(out, names[i]);
+		out.append(":[");
+		stream(i, from, to, out);
+		out.append("]");
+		first = false;
+	}
+	out.append("}");
+	return NULL;
+}
+
+void
+History::query(const String& request, MQTT& mqtt, const String& maintopic, int qos)
+{
+	// {"from": <epoch>, "to": <epoch>, "fields": [...], "id": ..., "response_topic": ...}
+	// called from the bus thread, so nothing may escape from here
+	if (map == NULL) {
+		return;
+	}
+	try {
+		String topic = maintopic + "/history";
+		std::string out;
+		out.append("{");
+		const char *error = "invalid request";
+		try {
+			JSON req;
+			req.parse(request);
+			if (req.is_object() && req.exists("id")) {
+				String id = req["id"].generate();
+				out.append("\"id\":");
+				out.append(id.c_str(), id.length());
+				out.append(",");
+			}
+			size_t header = out.length();
+			error = answer(req, maintopic, topic, out);
+			if (error != NULL) {
+				out.resize(header);
+				topic = maintopic + "/history";
+			}
+		} catch (...) {
+			out.resize(1);
+			topic = maintopic + "/history";
+		}
+		if (error != NULL) {
+			syslog(LOG_WARNING, "%s: history request rejected: %s", maintopic.c_str(), error);
+			out.append("\"error\":");
+			append_string(out, error);
+		}
+		out.append("}");
+		mqtt.publish_raw(topic, out.data(), out.length(), false, qos);
+	} catch (...) {
+		syslog(LOG_ERR, "%s: failed to answer history request", maintopic.c_str());
+	}
+}
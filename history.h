@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_HISTORY
+#define I_HISTORY
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <string>
+#include "mqtt.h"
+
+// memory mapped ring of recent samples per field, so dashboards get
+// the last minutes without a separate database, only used by the bus thread
+class History : public Base {
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t nfields;
+		uint32_t samples;
+		double resolution;
+	};
+	struct FieldHeader {
+		char name[64];
+		uint64_t head;
+		uint64_t count;
+		// absolute time (ms) and value of the oldest sample
+		int64_t base_time;
+		int64_t base_value;
+		// reconstructed newest sample, the next delta is relative to it
+		int64_t last_time;
+		int64_t last_value;
+	};
+	struct Sample {
+		uint32_t dt;
+		int32_t delta;
+	};
+	Array<String> names;
+	uint32_t samples;
+	double resolution;
+	int fd;
+	uint64_t mapsize;
+	uint8_t *map;
+	Header *hdr;
+	FieldHeader *fields;
+	Sample *ring;
+
+	void append(int64_t field, int64_t time, int64_t value);
+	void stream(int64_t field, int64_t from, int64_t to, std::string& out);
+	const char *answer(JSON& req, const String& maintopic, String& topic, std::string& out);
+
+public:
+	History();
+	~History();
+	void setup(JSON& hist_cfg, const String& file);
+	bool enabled() const;
+	void update(JSON& data, const struct timespec& now);
+	void query(const String& request, MQTT& mqtt, const String& maintopic, int qos);
+};
+
+#endif /* I_HISTORY */
@@ -31,11 +31,37 @@
 #include "main.h"
 #include <bwctmb/bwctmb.h>
 #include <mosquitto.h>
+#include <limits.h>
 #include "mqtt.h"
+#include "spool.h"
+#include "encoder.h"
+#include "pool.h"
+#include "aggregate.h"
+#include "counter.h"
+#include "device.h"
+#include "bus.h"
+#include "discover.h"
+#include "trace.h"
+#include "supervisor.h"
+#include "sched.h"
+#include "clock.h"
+#include "alloc.h"
+#include "realtime.h"
+#include "snapshot.h"
+#include "mbserver.h"
+#include "proxy.h"
 
 static a_refptr<JSON> config;
-static AArray<AArray<void (*)(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)>> devfunctions;
+static AArray<AArray<devfunction>> devfunctions;
+static AArray<AArray<Array<CounterTracker::Spec>>> devcounters;
+static AArray<AArray<int>> devpriorities;
+static ModbusServer mbserver;
+static CounterTracker counters;
 static MQTT main_mqtt;
+static Spool spool;
+static WorkerPool pool;
+static int spool_rate = 100;
+static String zdictdir = "/usr/local/share/mb_mqttbridge/zdict";
 
 #ifndef timespecsub
 #define timespecsub(tsp, usp, vsp)                                      \
@@ -72,1463 +98,373 @@ sighandler(int sig)
 	}
 }
 
-float
-reg_to_f (uint16_t d0, uint16_t d1) {
-	union {
-		float f;
-		uint16_t i[2];
-	};
-	i[0] = d0;
-	i[1] = d1;
-	return f;
-}
-
-String
-d_to_s(double val, int digits)
-{
-	String ret;
-	ret.printf("%.*lf", digits, val);
-
-	return ret;
-}
-
-void
-empty(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-}
-
 void
-Epever_Triron(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
+mqtt_setup(MQTT& mqtt, JSON& mqtt_cfg)
 {
-	{
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x3000, 9);
-			mqtt_data["PV array rated voltage"].set_number(d_to_s((double)int_inputs[0] / 100, 2));
-			mqtt_data["PV array rated current"].set_number(d_to_s((double)int_inputs[1] / 100, 2));
-			mqtt_data["PV array rated power"].set_number(d_to_s((double)((uint32_t)int_inputs[3] << 16 | int_inputs[2]) / 100, 2));
-			mqtt_data["rated voltage to battery"].set_number(d_to_s((double)int_inputs[4] / 100, 2));
-			mqtt_data["rated current to battery"].set_number(d_to_s((double)int_inputs[5] / 100, 2));
-			mqtt_data["rated power to battery"].set_number(d_to_s((double)((uint32_t)int_inputs[7] << 16 | int_inputs[6]) / 100, 2));
-			switch(int_inputs[8]) {
-			case 0x0000:
-				mqtt_data["charging mode"] =  "connect/disconnect";
-				break;
-			case 0x0001:
-				mqtt_data["charging mode"] = "PWM";
-				break;
-			case 0x0002:
-				mqtt_data["charging mode"] = "MPPT";
-				break;
-			}
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x300e, 1);
-			mqtt_data["rated current of load"].set_number(d_to_s((double)int_inputs[0] / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x3100, 4);
-			mqtt_data["PV voltage"].set_number(d_to_s((double)int_inputs[0] / 100, 2));
-			mqtt_data["PV current"].set_number(d_to_s((double)int_inputs[1] / 100, 2));
-			mqtt_data["PV power"].set_number(d_to_s((double)((int32_t)int_inputs[3] << 16 | int_inputs[2]) / 100, 2));
-		}
-		if (0) {
-			// value makes no sense, identic to PV power
-			auto int_inputs = mb.read_input_registers(address, 0x3106, 2);
-			mqtt_data["battery charging power"].set_number(d_to_s((double)((int32_t)int_inputs[1] << 16 | int_inputs[0]) / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x310c, 4);
-			mqtt_data["load voltage"].set_number(d_to_s((double)int_inputs[0] / 100, 2));
-			mqtt_data["load current"].set_number(d_to_s((double)int_inputs[1] / 100, 2));
-			mqtt_data["load power"].set_number(d_to_s((double)((int32_t)int_inputs[3] << 16 | int_inputs[2]) / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x3110, 2);
-			mqtt_data["battery temperature"].set_number(d_to_s((double)(int16_t)int_inputs[0] / 100, 2));
-			mqtt_data["case temperature"].set_number(d_to_s((double)(int16_t)int_inputs[1] / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x311a, 1);
-			mqtt_data["battery charged capacity"].set_number(d_to_s((double)int_inputs[0] / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x3201, 2);
-			int state;
-			state = (int_inputs[0] >> 2) & 0x3;
-			switch(state) {
-			case 0x0:
-				mqtt_data["charging status"] =  "no charging";
-				break;
-			case 0x1:
-				mqtt_data["charging status"] = "float";
-				break;
-			case 0x2:
-				mqtt_data["charging status"] = "boost";
-				break;
-			case 0x3:
-				mqtt_data["charging status"] = "equalization";
-				break;
-			}
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x331a, 3);
-			mqtt_data["battery voltage"].set_number(d_to_s((double)int_inputs[0] / 100, 2));
-			mqtt_data["battery current"].set_number(d_to_s((double)((int32_t)int_inputs[2] << 16 | int_inputs[1]) / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_holding_registers(address, 0x9000, 15);
-			switch(int_inputs[0]) {
-			case 0x0000:
-				mqtt_data["battery type"] = "user defined";
-				break;
-			case 0x0001:
-				mqtt_data["battery type"] = "sealed";
-				break;
-			case 0x0002:
-				mqtt_data["battery type"] = "GEL";
-				break;
-			case 0x0003:
-				mqtt_data["battery type"] = "flooded";
-				break;
-			}
-			mqtt_data["battery capacity"].set_number(S + int_inputs[1]);
-			mqtt_data["temperature compensation coefficient"].set_number(d_to_s((double)int_inputs[2] / 100, 2));
-			mqtt_data["high voltage disconnect"].set_number(d_to_s((double)int_inputs[3] / 100, 2));
-			mqtt_data["charging limit voltage"].set_number(d_to_s((double)int_inputs[4] / 100, 2));
-			mqtt_data["over voltage reconnect"].set_number(d_to_s((double)int_inputs[5] / 100, 2));
-			mqtt_data["equalization voltage"].set_number(d_to_s((double)int_inputs[6] / 100, 2));
-			mqtt_data["boost voltage"].set_number(d_to_s((double)int_inputs[7] / 100, 2));
-			mqtt_data["float voltage"].set_number(d_to_s((double)int_inputs[8] / 100, 2));
-			mqtt_data["boost reconnect voltage"].set_number(d_to_s((double)int_inputs[9] / 100, 2));
-			mqtt_data["low voltage reconnect"].set_number(d_to_s((double)int_inputs[10] / 100, 2));
-			mqtt_data["under voltage recover"].set_number(d_to_s((double)int_inputs[11] / 100, 2));
-			mqtt_data["under voltage warning"].set_number(d_to_s((double)int_inputs[12] / 100, 2));
-			mqtt_data["low voltage disconnect"].set_number(d_to_s((double)int_inputs[13] / 100, 2));
-			mqtt_data["discharging limit voltage"].set_number(d_to_s((double)int_inputs[14] / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x330a, 2);
-			mqtt_data["consumed energy"].set_number(d_to_s((double)((int32_t)int_inputs[1] << 16 | int_inputs[0]) / 100, 2));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x3312, 2);
-			mqtt_data["generated energy"].set_number(d_to_s((double)((int32_t)int_inputs[1] << 16 | int_inputs[0]) / 100, 2));
-		}
-	}
+	String host = mqtt_cfg["host"];
+	mqtt.host = host;
+	String port = mqtt_cfg["port"];
+	mqtt.port = port.getll();
+	String username = mqtt_cfg["username"];
+	mqtt.username = username;
+	String password = mqtt_cfg["password"];
+	mqtt.password = password;
+	if (mqtt_cfg.exists("protocol")) {
+		mqtt.protocol = mqtt_cfg["protocol"].get_numstr().getll();
+	}
+	if (mqtt_cfg.exists("topic_aliases")) {
+		bool topic_aliases = mqtt_cfg["topic_aliases"];
+		mqtt.topic_aliases = topic_aliases;
+	}
+	if (mqtt_cfg.exists("message_expiry")) {
+		mqtt.message_expiry = mqtt_cfg["message_expiry"].get_numstr().getll();
+	}
+	mqtt.spool = &spool;
 }
 
-void
-eastron_sdm630(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0000, 2 * 3);
-			mqtt_data["A phase voltage"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase voltage"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase voltage"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0006, 2 * 3);
-			mqtt_data["A phase current"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase current"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase current"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x000c, 2 * 3);
-			mqtt_data["A phase active power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase active power"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase active power"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0012, 2 * 3);
-			mqtt_data["A phase apparent power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase apparent power"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase apparent power"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0018, 2 * 3);
-			mqtt_data["A phase reactive power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase reactive power"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase reactive power"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x001e, 2 * 3);
-			mqtt_data["A phase power factor"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase power factor"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase power factor"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0024, 2 * 3);
-			mqtt_data["A phase angle"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase angle"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase angle"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x003c, 2 * 3);
-			mqtt_data["total reactive power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["total power factor"].set_number(d_to_s(reg_to_f(int_inputs[7], int_inputs[6]), 3));
-			mqtt_data["total angle"].set_number(d_to_s(reg_to_f(int_inputs[9], int_inputs[8]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0046, 2 * 5);
-			mqtt_data["frequency"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["forward active energy"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["reverse active energy"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-			mqtt_data["forward reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[7], int_inputs[6]), 3));
-			mqtt_data["reverse reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[9], int_inputs[8]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0054, 2 * 1);
-			mqtt_data["total active power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0064, 2 * 1);
-			mqtt_data["total apparent power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x015a, 2 * 6);
-			mqtt_data["A phase forward active energy"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase forward active energy"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase forward active energy"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-			mqtt_data["A phase reverse active energy"].set_number(d_to_s(reg_to_f(int_inputs[7], int_inputs[6]), 3));
-			mqtt_data["B phase reverse active energy"].set_number(d_to_s(reg_to_f(int_inputs[9], int_inputs[8]), 3));
-			mqtt_data["C phase reverse active energy"].set_number(d_to_s(reg_to_f(int_inputs[11], int_inputs[10]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x016c, 2 * 6);
-			mqtt_data["A phase forward reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["B phase forward reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["C phase forward reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-			mqtt_data["A phase reverse reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[7], int_inputs[6]), 3));
-			mqtt_data["B phase reverse reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[9], int_inputs[8]), 3));
-			mqtt_data["C phase reverse reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[11], int_inputs[10]), 3));
-		}
-	}
-}
-
-void
-eastron_sdm220(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0000, 2 * 1);
-			mqtt_data["A phase voltage"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0006, 2 * 1);
-			mqtt_data["A phase current"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x000c, 2 * 1);
-			mqtt_data["A phase active power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["total active power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0012, 2 * 1);
-			mqtt_data["A phase apparent power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["total apparent power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0018, 2 * 1);
-			mqtt_data["A phase reactive power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["total reactive power"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x001e, 2 * 1);
-			mqtt_data["A phase power factor"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["total power factor"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0024, 2 * 1);
-			mqtt_data["A phase angle"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["total angle"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-		}
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0046, 2 * 5);
-			mqtt_data["frequency"].set_number(d_to_s(reg_to_f(int_inputs[1], int_inputs[0]), 3));
-			mqtt_data["forward active energy"].set_number(d_to_s(reg_to_f(int_inputs[3], int_inputs[2]), 3));
-			mqtt_data["reverse active energy"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-			mqtt_data["forward reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[7], int_inputs[6]), 3));
-			mqtt_data["reverse reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[9], int_inputs[8]), 3));
-		}
-	}
-}
-
-void
-ZGEJ_powermeter(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		{
-			auto int_inputs = mb.read_input_registers(address, 0x0018, 2 * 34);
-			mqtt_data["A phase voltage"].set_number(d_to_s(reg_to_f(int_inputs[0], int_inputs[1]), 3));
-			mqtt_data["B phase voltage"].set_number(d_to_s(reg_to_f(int_inputs[2], int_inputs[3]), 3));
-			mqtt_data["C phase voltage"].set_number(d_to_s(reg_to_f(int_inputs[4], int_inputs[5]), 3));
-			mqtt_data["AB line voltage"].set_number(d_to_s(reg_to_f(int_inputs[6], int_inputs[7]), 3));
-			mqtt_data["BC line voltage"].set_number(d_to_s(reg_to_f(int_inputs[8], int_inputs[9]), 3));
-			mqtt_data["CA line voltage"].set_number(d_to_s(reg_to_f(int_inputs[10], int_inputs[11]), 3));
-			mqtt_data["A phase current"].set_number(d_to_s(reg_to_f(int_inputs[12], int_inputs[13]), 3));
-			mqtt_data["B phase current"].set_number(d_to_s(reg_to_f(int_inputs[14], int_inputs[15]), 3));
-			mqtt_data["C phase current"].set_number(d_to_s(reg_to_f(int_inputs[16], int_inputs[17]), 3));
-			mqtt_data["A phase active power"].set_number(d_to_s(reg_to_f(int_inputs[18], int_inputs[19]), 3));
-			mqtt_data["B phase active power"].set_number(d_to_s(reg_to_f(int_inputs[20], int_inputs[21]), 3));
-			mqtt_data["C phase active power"].set_number(d_to_s(reg_to_f(int_inputs[22], int_inputs[23]), 3));
-			mqtt_data["total active power"].set_number(d_to_s(reg_to_f(int_inputs[24], int_inputs[25]), 3));
-			mqtt_data["A phase reactive power"].set_number(d_to_s(reg_to_f(int_inputs[26], int_inputs[27]), 3));
-			mqtt_data["B phase reactive power"].set_number(d_to_s(reg_to_f(int_inputs[28], int_inputs[29]), 3));
-			mqtt_data["C phase reactive power"].set_number(d_to_s(reg_to_f(int_inputs[30], int_inputs[31]), 3));
-			mqtt_data["total reactive power"].set_number(d_to_s(reg_to_f(int_inputs[32], int_inputs[33]), 3));
-			mqtt_data["A phase apparent power"].set_number(d_to_s(reg_to_f(int_inputs[34], int_inputs[35]), 3));
-			mqtt_data["B phase apparent power"].set_number(d_to_s(reg_to_f(int_inputs[36], int_inputs[37]), 3));
-			mqtt_data["C phase apparent power"].set_number(d_to_s(reg_to_f(int_inputs[38], int_inputs[39]), 3));
-			mqtt_data["total apparent power"].set_number(d_to_s(reg_to_f(int_inputs[40], int_inputs[41]), 3));
-			mqtt_data["A phase power factor"].set_number(d_to_s(reg_to_f(int_inputs[42], int_inputs[43]), 3));
-			mqtt_data["B phase power factor"].set_number(d_to_s(reg_to_f(int_inputs[44], int_inputs[45]), 3));
-			mqtt_data["C phase power factor"].set_number(d_to_s(reg_to_f(int_inputs[46], int_inputs[47]), 3));
-			mqtt_data["total power factor"].set_number(d_to_s(reg_to_f(int_inputs[48], int_inputs[49]), 3));
-			mqtt_data["frequency"].set_number(d_to_s(reg_to_f(int_inputs[50], int_inputs[51]), 3));
-			mqtt_data["forward active energy 2"].set_number(d_to_s(reg_to_f(int_inputs[52], int_inputs[53]), 3));
-			mqtt_data["reverse active energy 2"].set_number(d_to_s(reg_to_f(int_inputs[54], int_inputs[55]), 3));
-			mqtt_data["forward reactive energy 2"].set_number(d_to_s(reg_to_f(int_inputs[56], int_inputs[57]), 3));
-			mqtt_data["reverse reactive energy 2"].set_number(d_to_s(reg_to_f(int_inputs[58], int_inputs[59]), 3));
-			mqtt_data["forward active energy"].set_number(d_to_s(reg_to_f(int_inputs[60], int_inputs[61]), 3));
-			mqtt_data["reverse active energy"].set_number(d_to_s(reg_to_f(int_inputs[62], int_inputs[63]), 3));
-			mqtt_data["forward reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[64], int_inputs[65]), 3));
-			mqtt_data["reverse reactive energy"].set_number(d_to_s(reg_to_f(int_inputs[66], int_inputs[67]), 3));
-		}
-	}
-}
-
-void
-eth_tpr(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "relay") {
-					Array<JSON>& relay = json[key].get_array();
-					for (int64_t x = 0; x <= relay.max && x < 2; x++) {
-						if (relay[x].is_boolean()) {
-							bool val = relay[x];
-							mb.write_coil(address, x, val);
-						}
-					}
-				}
-			}
-		}
-	}
-
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 4);
-		Array<JSON> inputs;
-
-		inputs[0] = bin_inputs[0];
-		inputs[1] = bin_inputs[1];
-		inputs[2] = bin_inputs[2];
-		inputs[3] = bin_inputs[3];
-		mqtt_data["input"] = inputs;
-	}
-	{
-		auto bin_coils = mb.read_coils(address, 0, 2);
-
-		Array<JSON> relay;
-		relay[0] = bin_coils[0];
-		relay[1] = bin_coils[1];
-		mqtt_data["relay"] = relay;
-	}
-}
-
-void
-mru_swg100(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		{
-			auto int_inputs = mb.read_input_registers(address, 0, 40);
-			AArray<JSON> values;
-			{
-				// 0 values[Analysator Status (weitere Informationen siehe unten)
-				uint32_t val = (uint32_t)int_inputs[0] << 16 | int_inputs[1];
-				values["Power-On"] = (bool)(val & 0x0001);
-				values["System-Alarm"] = (bool)(val & 0x0002);
-				values["Luftspülung"] = (bool)(val & 0x0004);
-				values["Messung (Vorbereitung der Messung, nicht am messen!)"] = (bool)(val & 0x0008);
-				values["Derzeitige Messstelle"].set_number((uint32_t)(val & 0x00f0) >> 4);
-				values["Ein Sensor wird gerade gespült"] = (bool)(val & 0x0000);
-				values["Ein Sensor ist gerade weggeschaltet"] = (bool)(val & 0x0000);
-				values["Gasmessung im Gehäuse"] = (bool)(val & 0x0000);
-				values["Stand-By"] = (bool)(val & 0x0000);
-				values["Auto-Kalibration"] = (bool)(val & 0x0000);
-				values["Service fällig"] = (bool)(val & 0x0000);
-				values["Warnung: Summe der gemessenen Gase ist > 100%"] = (bool)(val & 0x0000);
-				values["Steuerwort der Externen Steuerung"].set_number((uint32_t)(val & 0xf000) >> 12);
-			}
-			{
-				// 2 U32 System Alarm (weitere Informationen siehe unten)
-				uint32_t val = (uint32_t)int_inputs[2] << 16 | int_inputs[3];
-				values["Mainboard offline"] = (bool)(val & 0x0001);
-				values["Mainboard ist im Bootloader Modus"] = (bool)(val & 0x0002);
-				values["CH4 Umgebung > threshold value"] = (bool)(val & 0x0004);
-				values["Kondensat"] = (bool)(val & 0x0008);
-				values["Gasdurchfluss < 20 l/h"] = (bool)(val & 0x0010);
-				values["Lüfterdrehzahl < 900 min-1"] = (bool)(val & 0x0020);
-				values["T-Gaskühler zu hoch"] = (bool)(val & 0x0040);
-				values["T-Gaskühler zu niedrig"] = (bool)(val & 0x0080);
-				values["T-Sensor > 55°C"] = (bool)(val & 0x0100);
-				values["T-Sensor < 5°C"] = (bool)(val & 0x0200);
-				values["Gaskühler-Modul Offline"] = (bool)(val & 0x2000);
-				values["T-Vor-Gaskühler zu hoch"] = (bool)(val & 0x4000);
-				values["T-Vor-Gaskühler zu niedrig"] = (bool)(val & 0x8000);
-			}
-			values["Seriennummer"].set_number((uint32_t)int_inputs[4] << 16 | int_inputs[5]);
-			values["Analysatortyp"].set_number((uint32_t)int_inputs[6] << 16 | int_inputs[7]);
-			values["Firmware Version"].set_number((uint32_t)int_inputs[8] << 16 | int_inputs[9]);
-			values["Verstrichene Sekunden seit dem Einschalten"].set_number((uint32_t)int_inputs[10] << 16 | int_inputs[11]);
-			values["Fehlerzähler Modbus-Pakete"].set_number((uint32_t)int_inputs[12] << 16 | int_inputs[13]);
-			values["CH4 umgebung [%] voltage"].set_number(d_to_s(reg_to_f(int_inputs[15], int_inputs[14]), 3));
-			values["CH4 umgebung [% LEL]"].set_number(d_to_s(reg_to_f(int_inputs[17], int_inputs[16]), 3));
-			values["T-sensor [°C/°F]"].set_number(d_to_s(reg_to_f(int_inputs[19], int_inputs[18]), 3));
-			values["Gasdurchfluss [l/h]"].set_number(d_to_s(reg_to_f(int_inputs[21], int_inputs[20]), 3));
-			values["T-Gaskühler [°C/°F]"].set_number(d_to_s(reg_to_f(int_inputs[23], int_inputs[22]), 3));
-			values["Lüfterdrehzahl [U/min]"].set_number(d_to_s(reg_to_f(int_inputs[25], int_inputs[24]), 3));
-			values["Messpumpendrehzahl [U/min]"].set_number(d_to_s(reg_to_f(int_inputs[27], int_inputs[26]), 3));
-			values["P-barometrisch [hPa]"].set_number(d_to_s(reg_to_f(int_inputs[29], int_inputs[28]), 3));
-			values["P-barometrisch [inchHG]"].set_number(d_to_s(reg_to_f(int_inputs[31], int_inputs[30]), 3));
-			values["T-Vor-Gaskühler [°C/°F]"].set_number(d_to_s(reg_to_f(int_inputs[33], int_inputs[32]), 3));
-			mqtt_data["status"] = values;
-		}
-		{
-			Array<JSON> measurements;
-			for (int i = 0; i < 2; i++) {
-				auto int_inputs = mb.read_input_registers(address, 40 + i * 30, 30);
-				AArray<JSON> values;
-				{
-					// 0 values[Analysator Status (weitere Informationen siehe unten)
-					uint32_t val = (uint32_t)int_inputs[0] << 16 | int_inputs[1];
-					values["Power-On"] = (bool)(val & 0x0001);
-					values["System-Alarm"] = (bool)(val & 0x0002);
-					values["Luftspülung"] = (bool)(val & 0x0004);
-					values["Messung (Vorbereitung der Messung, nicht am messen!)"] = (bool)(val & 0x0008);
-					values["Derzeitige Messstelle"].set_number((uint32_t)(val & 0x00f0) >> 4);
-					values["Ein Sensor wird gerade gespült"] = (bool)(val & 0x0000);
-					values["Ein Sensor ist gerade weggeschaltet"] = (bool)(val & 0x0000);
-					values["Gasmessung im Gehäuse"] = (bool)(val & 0x0000);
-					values["Stand-By"] = (bool)(val & 0x0000);
-					values["Auto-Kalibration"] = (bool)(val & 0x0000);
-					values["Service fällig"] = (bool)(val & 0x0000);
-					values["Warnung: Summe der gemessenen Gase ist > 100%"] = (bool)(val & 0x0000);
-					values["Steuerwort der Externen Steuerung"].set_number((uint32_t)(val & 0xf000) >> 12);
-				}
-				{
-					// 2 U32 System Alarm (weitere Informationen siehe unten)
-					uint32_t val = (uint32_t)int_inputs[2] << 16 | int_inputs[3];
-					values["Mainboard offline"] = (bool)(val & 0x0001);
-					values["Mainboard ist im Bootloader Modus"] = (bool)(val & 0x0002);
-					values["CH4 Umgebung > threshold value"] = (bool)(val & 0x0004);
-					values["Kondensat"] = (bool)(val & 0x0008);
-					values["Gasdurchfluss < 20 l/h"] = (bool)(val & 0x0010);
-					values["Lüfterdrehzahl < 900 min-1"] = (bool)(val & 0x0020);
-					values["T-Gaskühler zu hoch"] = (bool)(val & 0x0040);
-					values["T-Gaskühler zu niedrig"] = (bool)(val & 0x0080);
-					values["T-Sensor > 55°C"] = (bool)(val & 0x0100);
-					values["T-Sensor < 5°C"] = (bool)(val & 0x0200);
-					values["Gaskühler-Modul Offline"] = (bool)(val & 0x2000);
-					values["T-Vor-Gaskühler zu hoch"] = (bool)(val & 0x4000);
-					values["T-Vor-Gaskühler zu niedrig"] = (bool)(val & 0x8000);
-				}
-				values["O2 [%]"].set_number(d_to_s(reg_to_f(int_inputs[5], int_inputs[4]), 3));
-				values["CO2 [%]"].set_number(d_to_s(reg_to_f(int_inputs[7], int_inputs[6]), 3));
-				values["CH4 [%]"].set_number(d_to_s(reg_to_f(int_inputs[9], int_inputs[8]), 3));
-				values["H2S [ppm]"].set_number(d_to_s(reg_to_f(int_inputs[11], int_inputs[10]), 3));
-				values["H2 [ppm]"].set_number(d_to_s(reg_to_f(int_inputs[13], int_inputs[12]), 3));
-				values["Heizwert [MJ/kg]"].set_number(d_to_s(reg_to_f(int_inputs[15], int_inputs[14]), 3));
-				values["Brennwert [MJ/kg]"].set_number(d_to_s(reg_to_f(int_inputs[17], int_inputs[16]), 3));
-				values["Heizwert [MJ/m³]"].set_number(d_to_s(reg_to_f(int_inputs[19], int_inputs[18]), 3));
-				values["Brennwert [MJ/m³]"].set_number(d_to_s(reg_to_f(int_inputs[21], int_inputs[20]), 3));
-				values["CO [ppm]"].set_number(d_to_s(reg_to_f(int_inputs[23], int_inputs[22]), 3));
-				values["CH4 [ppm]"].set_number(d_to_s(reg_to_f(int_inputs[25], int_inputs[24]), 3));
-				values["CO2 [ppm]"].set_number(d_to_s(reg_to_f(int_inputs[27], int_inputs[26]), 3));
-				values["N2 [%]"].set_number(d_to_s(reg_to_f(int_inputs[29], int_inputs[28]), 3));
-				measurements[i] = values;
-			}
-			mqtt_data["measurements"] = measurements;
-		}
-	}
-}
-
-void
-eth_tpr_ldr(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "relay") {
-					Array<JSON>& relay = json[key].get_array();
-					for (int64_t x = 0; x <= relay.max && x < 2; x++) {
-						if (relay[x].is_boolean()) {
-							bool val = relay[x];
-							mb.write_coil(address, x, val);
-						}
-					}
-				}
-			}
-		}
-	}
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 4);
-		Array<JSON> inputs;
-
-		inputs[0] = bin_inputs[0];
-		inputs[1] = bin_inputs[1];
-		inputs[2] = bin_inputs[2];
-		inputs[3] = bin_inputs[3];
-		mqtt_data["input"] = inputs;
-	}
-	{
-		auto bin_coils = mb.read_coils(address, 0, 2);
-
-		Array<JSON> relay;
-		relay[0] = bin_coils[0];
-		relay[1] = bin_coils[1];
-		mqtt_data["relay"] = relay;
-	}
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 14);
-
-		{
-			// 16bit counter - should verify for rollover and restart
-			Array<JSON> counters;
-			counters[0].set_number(S + int_inputs[0]);
-			counters[1].set_number(S + int_inputs[1]);
-			counters[2].set_number(S + int_inputs[2]);
-			counters[3].set_number(S + int_inputs[3]);
-
-			// 32 bit counter - should verify for rollover and restart
-			{
-				uint32_t tmp = (uint32_t)int_inputs[6] | (uint32_t)int_inputs[7] << 16;
-				counters[4].set_number(S + tmp);
-			}
-			{
-				uint32_t tmp = (uint32_t)int_inputs[8] | (uint32_t)int_inputs[9] << 16;
-				counters[5].set_number(S + tmp);
-			}
-			{
-				uint32_t tmp = (uint32_t)int_inputs[10] | (uint32_t)int_inputs[11] << 16;
-				counters[6].set_number(S + tmp);
-			}
-			{
-				uint32_t tmp = (uint32_t)int_inputs[12] | (uint32_t)int_inputs[13] << 16;
-				counters[7].set_number(S + tmp);
-			}
-
-			mqtt_data["counters"] = counters;
-		}
-
-		{
-			Array<JSON> ldrs;
-			ldrs[0].set_number(S + int_inputs[4]);
-			// XXX check firmware version for functional LDR1 input
-			ldrs[1].set_number(S + int_inputs[5]);
-			mqtt_data["ldrs"] = ldrs;
-		}
-
-	}
-
-	if (dev_cfg.exists("DS18B20")) {
-		Array<JSON> ds18b20;
-		int64_t max_sensor = dev_cfg["DS18B20"].get_array().max;
-		for (int64_t i = 0; i <= max_sensor; i++) {
-			int16_t sensor_register = dev_cfg["DS18B20"][i]["register"].get_numstr().getll();
-			try {
-				uint16_t value = mb.read_input_register(address, sensor_register);
-				double temp = (double)value / 16;
-				AArray<JSON> sensor;
-				sensor["temperature"].set_number(d_to_s(temp, 4));
-				ds18b20[i] = sensor;
-			} catch (...) {
-			}
-		}
-		mqtt_data["ds18b20"] = ds18b20;
-	}
-}
-
-void
-rs485_jalousie(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "relay") {
-					Array<JSON>& relay = json[key].get_array();
-					for (int64_t x = 0; x <= relay.max && x < 6; x++) {
-						if (relay[x].is_boolean()) {
-							bool val = relay[x];
-							mb.write_coil(address, x, val);
-						}
-					}
-				}
-			}
-		}
-	}
-
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 4);
-		Array<JSON> inputs;
-
-		inputs[0] = bin_inputs[0];
-		inputs[1] = bin_inputs[1];
-		inputs[2] = bin_inputs[2];
-		inputs[3] = bin_inputs[3];
-		mqtt_data["input"] = inputs;
-	}
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 8);
-
-		Array<JSON> inputs;
-		for (int64_t i = 0; i < 8; i++) {
-			inputs[i] = bin_inputs[i];
-		}
-		mqtt_data["input"] = inputs;
-	}
-
-	{
-		auto bin_coils = mb.read_coils(address, 0, 6);
-
-		Array<JSON> relay;
-		for (int64_t i = 0; i < 6; i++) {
-			relay[i] = bin_coils[i];
-		}
-		mqtt_data["relay"] = relay;
-	}
-}
-
-void
-rs485_relais6(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "relay") {
-					Array<JSON>& relay = json[key].get_array();
-					for (int64_t x = 0; x <= relay.max && x < 6; x++) {
-						if (relay[x].is_boolean()) {
-							bool val = relay[x];
-							mb.write_coil(address, x, val);
-						}
-					}
-				}
-			}
-		}
-	}
-
-	// XXX no counter support yet
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 8);
-
-		Array<JSON> inputs;
-		for (int64_t i = 0; i < 8; i++) {
-			inputs[i] = bin_inputs[i];
-		}
-		mqtt_data["input"] = inputs;
-	}
-
-	{
-		auto bin_coils = mb.read_coils(address, 0, 6);
-
-		Array<JSON> relay;
-		for (int64_t i = 0; i < 6; i++) {
-			relay[i] = bin_coils[i];
-		}
-		mqtt_data["relay"] = relay;
-	}
-}
-
-void
-rs485_shtc3(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	auto int_inputs = mb.read_input_registers(address, 0, 2);
-	double temp = (double)(int16_t)int_inputs[0] / 10.0;
-	double humid = (double)int_inputs[1] / 10.0;
-	Array<JSON> shtc;
-	AArray<JSON> sensor;
-	sensor["temperature"].set_number(d_to_s(temp, 1));
-	sensor["humidity"].set_number(d_to_s(humid, 1));
-	shtc[0] = sensor;
-	mqtt_data["SHTC3"] = shtc;
-}
-
-void
-rs485_laserdistance(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	auto int_inputs = mb.read_input_registers(address, 0, 3);
-	{
-		Array<JSON> weights;
-		int32_t tmp = (uint32_t)int_inputs[0] | (uint32_t)int_inputs[1] << 16;
-		weights[0].set_number(S + tmp);
-		mqtt_data["weight"] = weights;
-	}
-	{
-		Array<JSON> distances;
-		distances[0].set_number(S + int_inputs[2]);
-		mqtt_data["distance"] = distances;
-	}
-}
-
-void
-eth_io88(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	uint32_t major = -1;
-	uint32_t minor = -1;
-
-	if (devdata.exists("version")) {
-		Array<String> v = devdata["version"].split(".");
-		if (v.max >= 0) {
-			major = v[0].getll();
-		}
-		if (v.max >= 1) {
-			minor = v[1].getll();
-		}
-	}
-
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "output") {
-					Array<JSON>& output = json[key].get_array();
-					for (int64_t x = 0; x <= output.max && x < 8; x++) {
-						if (output[x].is_boolean()) {
-							bool val = output[x];
-							mb.write_coil(address, x, val);
-						}
-					}
-				} else if (key == "pwm_enable") {
-					Array<JSON>& tmp = json[key].get_array();
-					for (int64_t x = 0; x <= tmp.max && x < 8; x++) {
-						if (tmp[x].is_boolean()) {
-							bool val = tmp[x];
-							mb.write_coil(address, x + 8, val);
-						}
-					}
-				} else if (key == "pwm_value") {
-					Array<JSON>& tmp = json[key].get_array();
-					for (int64_t x = 0; x <= tmp.max && x < 8; x++) {
-						if (tmp[x].is_number()) {
-							uint16_t val = tmp[x].get_numstr().getll();
-							mb.write_coil(address, x, val);
-						}
-					}
-				} else if (key == "pwm_max") {
-					Array<JSON>& tmp = json[key].get_array();
-					for (int64_t x = 0; x <= tmp.max && x < 8; x++) {
-						if (tmp[x].is_number()) {
-							uint16_t val = tmp[x].get_numstr().getll();
-							mb.write_coil(address, x + 8, val);
-						}
-					}
-				}
-			}
-		}
-	}
-
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 8);
-
-		Array<JSON> inputs;
-		for (int i = 0; i < 8; i++) {
-			inputs[i] = bin_inputs[i];
-		}
-		mqtt_data["input"] = inputs;
-	}
-
-	{
-		auto data = mb.read_coils(address, 0, 16);
-
-		Array<JSON> outputs;
-		for (int i = 0; i < 8; i++) {
-			outputs[i] = data[i];
-		}
-		mqtt_data["output"] = outputs;
-
-		Array<JSON> pwm_enables;
-		for (int i = 0; i < 8; i++) {
-			pwm_enables[i] = data[i + 8];
-		}
-		mqtt_data["pwm_enable"] = pwm_enables;
-	}
-
-	{
-		auto data = mb.read_holding_registers(address, 0, 16);
-
-		Array<JSON> pwm_values;
-		for (int i = 0; i < 8; i++) {
-			pwm_values[i] = (int64_t)data[i];
-		}
-		mqtt_data["pwm_value"] = pwm_values;
-
-		Array<JSON> pwm_max;
-		for (int i = 0; i < 8; i++) {
-			pwm_max[i] = (int64_t)data[i + 8];
-		}
-		mqtt_data["pwm_max"] = pwm_max;
-	}
-
-	if (major >= 0 && minor >= 7) {
-		auto bin_counter = mb.read_input_registers(address, 0, 4 * 8);
-
-		Array<JSON> counters;
-		uint64_t vals[8];
-		for (int i = 0; i < 8; i++) {
-			uint64_t tmp = 0;
-			for (int j = 0; j < 4; j++) {
-				tmp |= bin_counter[i * 4 + j] << (j * 16);
-			}
-			counters[i].set_number(S + tmp);
-			vals[i] = tmp;
-		}
-		mqtt_data["counter"] = counters;
-	}
-
-	if (major >= 0 && minor >= 8) {
-		auto bin_times = mb.read_input_registers(address, 32, 2 * 8);
-
-		Array<JSON> times;
-		for (int i = 0; i < 8; i++) {
-			uint64_t tmp = 0;
-			for (int j = 0; j < 2; j++) {
-				tmp |= bin_times[i * 4 + j] << (j * 16);
-			}
-			times[i].set_number(d_to_s((((double)tmp) / 10000.0), 2));
-		}
-		mqtt_data["counttime"] = times;
-	}
-
-	if (major >= 0 && minor >= 10) {
-		auto bin_times = mb.read_input_registers(address, 48, 2 * 8);
-
-		Array<JSON> times;
-		for (int i = 0; i < 8; i++) {
-			uint64_t tmp = 0;
-			for (int j = 0; j < 2; j++) {
-				tmp |= bin_times[i * 4 + j] << (j * 16);
-			}
-			times[i].set_number(d_to_s((((double)tmp) / 10000.0), 2));
-		}
-		mqtt_data["counttime_timer"] = times;
-	}
-}
-
-void
-eth_io88p(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	eth_io88(mb, rxbuf, mqtt_data, address, maintopic, devdata, dev_cfg);
-
-	if (dev_cfg.exists("DS18B20")) {
-		Array<JSON> ds18b20;
-		int64_t max_sensor = dev_cfg["DS18B20"].get_array().max;
-		for (int64_t i = 0; i <= max_sensor; i++) {
-			int16_t sensor_register = dev_cfg["DS18B20"][i]["register"].get_numstr().getll();
-			try {
-				uint16_t value = mb.read_input_register(address, sensor_register);
-				double temp = (double)value / 16;
-				AArray<JSON> sensor;
-				sensor["temperature"].set_number(d_to_s(temp, 4));
-				ds18b20[i] = sensor;
-			} catch (...) {
-			}
-		}
-		mqtt_data["ds18b20"] = ds18b20;
-	}
-}
-
-void
-rs485_io88(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "output") {
-					Array<JSON>& output = json[key].get_array();
-					for (int64_t x = 0; x <= output.max && x < 8; x++) {
-						if (output[x].is_boolean()) {
-							bool val = output[x];
-							mb.write_coil(address, x, val);
-						}
-					}
-				} else if (key == "pwm") {
-					Array<JSON>& pwm = json[key].get_array();
-					for (int64_t x = 0; x <= pwm.max; x++) {
-						if (pwm[x].is_number()) {
-							uint16_t val = pwm[x].get_numstr().getll();
-							mb.write_register(address, x, val);
-						}
-					}
-				}
-			}
-		}
-	}
-
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 8);
-
-		Array<JSON> inputs;
-		for (int i = 0; i < 8; i++) {
-			inputs[i] = bin_inputs[i];
-		}
-		mqtt_data["input"] = inputs;
-	}
-
-	{
-		auto bin_coils = mb.read_coils(address, 0, 8);
-
-		Array<JSON> outputs;
-		for (int i = 0; i < 8; i++) {
-			outputs[i] = bin_coils[i];
-		}
-		mqtt_data["output"] = outputs;
-	}
-}
-
-void
-rs485_adc_dac(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "dac") {
-					Array<JSON>& dac = json[key].get_array();
-					for (int64_t x = 0; x <= dac.max && x < 2; x++) {
-						if (dac[x].is_number()) {
-							double tmp = dac[x].get_numstr().getd();
-							tmp = tmp / 11.0 * 1.0; // normalize for output resistors
-							tmp = tmp * (1 << 12) / 2.048; // normalize for DAC value range
-							uint16_t val = tmp;
-							mb.write_register(address, x, val);
-						}
-					}
-				}
-			}
-		}
-	}
-
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 10);
-		Array<JSON> adc;
-		for (int i = 0; i < 4; i++) {
-			const int reg_values[] = {2, 1, 8, 7};
-			double tmp = int_inputs[reg_values[i]];
-			tmp = tmp / (1 << 10) * 1.1; // normalize for ADC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for input resistors
-			adc[i].set_number(d_to_s(tmp, 3));
-		}
-		mqtt_data["adc"] = adc;
-		mqtt_data["ref"].set_number(S + int_inputs[9]);
-	}
-
-	{
-		auto int_outputs = mb.read_holding_registers(address, 0, 2);
-		Array<JSON> dac;
-		for (int i = 0; i < 2; i++) {
-			double tmp = int_outputs[i];
-			tmp = tmp / (1 << 12) * 2.048; // normalize for DAC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for output resistors
-			dac[i].set_number(d_to_s(tmp, 3));
-		}
-		mqtt_data["dac"] = dac;
-	}
+CounterTracker::Spec
+counter_spec(const String& field, int64_t first, int64_t count, int bits)
+{
+	CounterTracker::Spec spec;
+	spec.field = field;
+	spec.first = first;
+	spec.count = count;
+	spec.bits = bits;
+	return spec;
 }
 
 void
-rs485_adc_dac_30(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
+track_counters(JSON& mqtt_data, Array<CounterTracker::Spec>& specs, Array<int64_t>& slots, CounterTracker::Group& counters, double now)
 {
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "dac") {
-					Array<JSON>& dac = json[key].get_array();
-					for (int64_t x = 0; x <= dac.max && x < 2; x++) {
-						if (dac[x].is_number()) {
-							double tmp = dac[x].get_numstr().getd();
-							tmp = tmp / 11.0 * 1.0; // normalize for output resistors
-							tmp = tmp * (1 << 12) / 2.048; // normalize for DAC value range
-							uint16_t val = tmp;
-							mb.write_register(address, x, val);
-						}
-					}
+	int64_t n = 0;
+
+	for (int64_t i = 0; i <= specs.max; i++) {
+		CounterTracker::Spec& spec = specs[i];
+		if (!mqtt_data.exists(spec.field)) {
+			n += spec.count;
+			continue;
+		}
+		String total_field = spec.field + "_total";
+		String rate_field = spec.field + "_rate";
+		if (spec.first >= 0 && !mqtt_data.exists(total_field)) {
+			Array<JSON> tmp;
+			mqtt_data[total_field] = tmp;
+			mqtt_data[rate_field] = tmp;
+		}
+		for (int64_t j = 0; j < spec.count; j++, n++) {
+			JSON *value = &mqtt_data[spec.field];
+			if (spec.first >= 0) {
+				if (spec.first + j > value->get_array().max) {
+					continue;
 				}
+				value = &value->get_array()[spec.first + j];
+			}
+			if (!slots.exists(n)) {
+				slots[n] = counters.slot(spec.field + "/" + (spec.first + j));
+			}
+			uint64_t raw = strtoull(value->get_numstr().c_str(), NULL, 10);
+			uint64_t total;
+			double rate;
+			counters.update(slots[n], raw, spec.bits, now, total, rate);
+			if (spec.first >= 0) {
+				mqtt_data[total_field].get_array()[spec.first + j].set_number(S + total);
+				mqtt_data[rate_field].get_array()[spec.first + j].set_number(d_to_s(rate, 3));
+			} else {
+				mqtt_data[total_field].set_number(S + total);
+				mqtt_data[rate_field].set_number(d_to_s(rate, 3));
 			}
 		}
 	}
-
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 10);
-		Array<JSON> adc;
-		for (int i = 0; i < 4; i++) {
-			const int reg_values[] = {2, 1, 8, 7};
-			double tmp = int_inputs[reg_values[i]];
-			tmp = tmp / (1 << 10) * 1.1; // normalize for ADC value range
-			tmp = tmp * (10000 + 560) / 560; // normalize for input resistors
-			adc[i].set_number(d_to_s(tmp, 3));
-		}
-		mqtt_data["adc"] = adc;
-		mqtt_data["ref"].set_number(S + int_inputs[9]);
-	}
-
-	{
-		auto int_outputs = mb.read_holding_registers(address, 0, 2);
-		Array<JSON> dac;
-		for (int i = 0; i < 2; i++) {
-			double tmp = int_outputs[i];
-			tmp = tmp / (1 << 12) * 2.048; // normalize for DAC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for output resistors
-			dac[i].set_number(d_to_s(tmp, 3));
-		}
-		mqtt_data["dac"] = dac;
-	}
 }
 
 void
-rs485_adc_dac_2_dacs(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
+publish_job(WorkerPool::Job& job)
 {
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "dac") {
-					Array<JSON>& dac = json[key].get_array();
-					for (int64_t x = 0; x <= dac.max && x < 2; x++) {
-						if (dac[x].is_number()) {
-							double tmp = dac[x].get_numstr().getd();
-							tmp = tmp / 11.0 * 1.0; // normalize for output resistors
-							tmp = tmp * (1 << 12) / 2.048; // normalize for DAC value range
-							uint16_t val = tmp;
-							mb.write_register(address, x, val);
-						}
+	Device& dev = *job.dev;
+	MQTT& mqtt = dev.mqtt;
+	ArenaScope arena_scope(dev.arena);
+
+	if (job.has_data) {
+		Encoder& encoder = dev.encoder;
+		String json;
+		const void *payload;
+		size_t len;
+		if (encoder.binary()) {
+			TraceSpan span("encode");
+			const std::string& data = encoder.encode(job.data);
+			if (encoder.schema_pending()) {
+				mqtt.publish(dev.schema_topic, encoder.schema(), true, false, dev.qos);
+			}
+			payload = data.data();
+			len = data.length();
+		} else {
+			TraceSpan span("generate");
+			json = job.data.generate();
+			payload = json.c_str();
+			len = json.length();
+		}
+		Compressor& compressor = dev.compressor;
+		if (compressor.enabled()) {
+			TraceSpan span("compress");
+			try {
+				if (!compressor.has_dictionary()) {
+					// the dictionary built for the handler fits JSON only
+					String file = zdictdir + "/" + Compressor::dictionary_name(dev.vendor, dev.product);
+					if (encoder.binary() || !compressor.load_dictionary(file)) {
+						compressor.set_dictionary(payload, len);
+					}
+				}
+				// frames are published under the id of their dictionary,
+				// which is retried until the broker took it
+				const String& dict_id = compressor.dictionary_id();
+				if (compressor.dictionary_pending()) {
+					const std::string& dict = compressor.dictionary();
+					if (mqtt.publish_raw(dev.dict_topic + "/" + dict_id, dict.data(), dict.length(), true, dev.qos)) {
+						compressor.dictionary_published();
 					}
 				}
+				const std::string& data = compressor.compress(payload, len);
+				String zstd_topic = dev.zstd_topic + "/" + dict_id;
+				mqtt.add_alias(zstd_topic);
+				mqtt.publish_spooled(zstd_topic, data.data(), data.length(), dev.qos, job.timestamp);
+			} catch (...) {
+				syslog(LOG_ERR, "%s: compression failed", dev.maintopic.c_str());
 			}
+		} else {
+			mqtt.publish_spooled(dev.data_topic, payload, len, dev.qos, job.timestamp);
 		}
 	}
-
-	{
-		auto int_outputs = mb.read_holding_registers(address, 0, 4);
-		Array<JSON> dac;
-		for (int i = 0; i < 2; i++) {
-			double tmp = int_outputs[i];
-			tmp = tmp / (1 << 12) * 2.048; // normalize for DAC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for output resistors
-			dac[i].set_number(d_to_s(tmp, 3));
-		}
-		mqtt_data["dac"] = dac;
-	}
+	mqtt.publish(dev.status_topic, job.status, false, false, dev.qos);
 }
 
 void
-rs485_adc_dac_2(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
+history_queries(Device& dev, Array<MQTT::RXbuf>& rxbuf)
 {
-	rs485_adc_dac_2_dacs(mb, rxbuf, mqtt_data, address, maintopic, devdata, dev_cfg);
-
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 4);
-		Array<JSON> adc;
-		for (int i = 0; i < 4; i++) {
-			double tmp = int_inputs[i];
-			tmp = tmp / (1 << 10) * 1.1; // normalize for ADC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for input resistors
-			adc[i].set_number(d_to_s(tmp, 3));
-		}
-		mqtt_data["adc"] = adc;
+	// answered from the ring, whether the poll worked or not, History::query
+	// doesn't throw
+	if (!dev.history.enabled()) {
+		return;
 	}
-}
-
-void
-rs485_adcp_dac_2(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	rs485_adc_dac_2(mb, rxbuf, mqtt_data, address, maintopic, devdata, dev_cfg);
-
-	{
-		auto int_inputs = mb.read_input_registers(address, 5, 8);
-		Array<JSON> adc;
-		for (int i = 0; i < 4; i++) {
-			double tmp = int_inputs[i * 2] | (int_inputs[i * 2 + 1] << 16);
-			tmp = tmp / (1 << 10) * 1.1; // normalize for ADC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for input resistors
-			adc[i].set_number(d_to_s(tmp, 3));
+	for (int64_t r = 0; r <= rxbuf.max; r++) {
+		if (rxbuf[r].topic == dev.history_topic) {
+			dev.history.query(rxbuf[r].message, dev.mqtt, dev.maintopic, dev.qos);
 		}
-		mqtt_data["adc2"] = adc;
 	}
 }
 
 void
-rs485_adcc_dac_2(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
+device_setup(Device& dev, JSON& dev_cfg, JSON& mqtt_cfg, const String& host, const String& port)
 {
-	rs485_adc_dac_2_dacs(mb, rxbuf, mqtt_data, address, maintopic, devdata, dev_cfg);
-
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 4);
-		Array<JSON> adc;
-		for (int i = 0; i < 4; i++) {
-			double tmp = int_inputs[i];
-			tmp = tmp / (1 << 10) * 1.1; // normalize for ADC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for input resistors
-			// XXX TODO convert to current
-			adc[i].set_number(d_to_s(tmp, 3));
+	dev.cfg = &dev_cfg;
+	dev.address = dev_cfg["address"].get_numstr().getll();
+	dev.qos = 0;
+	if (dev_cfg.exists("qos")) {
+		dev.qos = dev_cfg["qos"].get_numstr().getll();
+	}
+	dev.interval = 1.0;
+	if (dev_cfg.exists("min_pollintervall")) {
+		String tmp = dev_cfg["min_pollintervall"].get_numstr();
+		dev.interval = (double)tmp.getd();
+	}
+	String maintopic = dev_cfg["maintopic"];
+	dev.maintopic = maintopic;
+	dev.data_topic = maintopic + "/data";
+	dev.status_topic = maintopic + "/status";
+	dev.schema_topic = maintopic + "/schema";
+	dev.cmd_topic = maintopic + "/cmd";
+	dev.zstd_topic = maintopic + "/data/zstd";
+	dev.dict_topic = maintopic + "/zdict";
+	dev.history_topic = maintopic + "/history/get";
+	dev.counters = counters.group(S + host + ":" + port + "/" + dev.address);
+	dev.identified = false;
+	dev.major = -1;
+	dev.minor = -1;
+	dev.handler = NULL;
+	dev.track_counters = false;
+	if (dev_cfg.exists("track_counters")) {
+		bool track = dev_cfg["track_counters"];
+		dev.track_counters = track;
+	}
+	dev.priority = -1;
+	if (dev_cfg.exists("priority")) {
+		String prio = dev_cfg["priority"];
+		try {
+			dev.priority = BusScheduler::parse_class(prio);
+		} catch (...) {
+			syslog(LOG_ERR, "%s: unknown priority class %s", maintopic.c_str(), prio.c_str());
+		}
+	}
+	dev.write_cache = false;
+	dev.write_cache_verify = 60;
+	if (dev_cfg.exists("write_cache")) {
+		JSON& wc_cfg = dev_cfg["write_cache"];
+		dev.write_cache = true;
+		if (wc_cfg.exists("verify")) {
+			String tmp = wc_cfg["verify"].get_numstr();
+			dev.write_cache_verify = tmp.getd();
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &dev.lasttime);
+
+	MQTT& mqtt = dev.mqtt;
+	String id = mqtt_cfg["id"];
+	if (!id.empty()) {
+		id += S + "[" + host + "]" + port + "/" + dev.address;
+	}
+	mqtt.id = id;
+	mqtt_setup(mqtt, mqtt_cfg);
+	mqtt.maintopic = maintopic;
+	mqtt.rxbuf_enable = true;
+	// only topics published with every poll are worth an alias
+	mqtt.add_alias(dev.data_topic);
+	mqtt.add_alias(dev.status_topic);
+	mqtt.connect();
+
+	if (dev_cfg.exists("encoding")) {
+		String encoding = dev_cfg["encoding"];
+		try {
+			dev.encoder.set_format(encoding);
+		} catch (...) {
+			syslog(LOG_ERR, "%s: unknown encoding %s", maintopic.c_str(), encoding.c_str());
+		}
+	}
+	if (dev_cfg.exists("aggregate")) {
+		dev.aggregator.setup(dev_cfg["aggregate"], dev.interval);
+	}
+	if (dev_cfg.exists("history")) {
+		JSON& hist_cfg = dev_cfg["history"];
+		String file = S + "/var/db/mb_mqttbridge." + host + "_" + port + "_" + dev.address + ".history";
+		if (hist_cfg.exists("file")) {
+			String tmp = hist_cfg["file"];
+			file = tmp;
+		}
+		try {
+			dev.history.setup(hist_cfg, file);
+		} catch (...) {
+			syslog(LOG_ERR, "%s: failed to set up history %s", maintopic.c_str(), file.c_str());
+		}
+	}
+	if (dev_cfg.exists("compress")) {
+		int level = dev_cfg["compress"].get_numstr().getll();
+		String file = S + "/var/db/mb_mqttbridge." + host + "_" + port + "_" + dev.address + ".zdict";
+		if (dev_cfg.exists("compress_dictionary")) {
+			String tmp = dev_cfg["compress_dictionary"];
+			file = tmp;
+		}
+		try {
+			dev.compressor.setup(level, file);
+		} catch (...) {
+			syslog(LOG_ERR, "%s: compression not available", maintopic.c_str());
 		}
-		mqtt_data["adc"] = adc;
 	}
 }
 
 void
-rs485_adccp_dac_2(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
+device_blocks(Bus& mb, Device& dev)
 {
-	rs485_adcc_dac_2(mb, rxbuf, mqtt_data, address, maintopic, devdata, dev_cfg);
+	JSON& dev_cfg = *dev.cfg;
 
-	{
-		auto int_inputs = mb.read_input_registers(address, 5, 8);
-		Array<JSON> adc;
-		for (int i = 0; i < 4; i++) {
-			double tmp = int_inputs[i * 2] | (int_inputs[i * 2 + 1] << 16);
-			tmp = tmp / (1 << 10) * 1.1; // normalize for ADC value range
-			tmp = tmp * 11.0 / 1.0; // normalize for input resistors
-			// XXX TODO convert to current
-			adc[i].set_number(d_to_s(tmp, 3));
-		}
-		mqtt_data["adc2"] = adc;
+	if (dev_cfg.exists("block_timestamps")) {
+		bool enable = dev_cfg["block_timestamps"];
+		mb.set_block_timestamps(dev.address, enable);
 	}
-}
-
-void
-rs485_rfid125_disp(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 11);
-		if (int_inputs[0] != 0) {
-			String key;
-			String tmp;
-			uint8_t nibble;
-			for (int i = 1; i <= int_inputs[0]; i++) {
-				nibble = (int_inputs[i] >> 4) & 0x0f;
-				tmp.printf("%c", (nibble > 9) ? 'a' - 10 + nibble : '0' + nibble);
-				key += tmp;
-				nibble = int_inputs[i] & 0x0f;
-				tmp.printf("%c", (nibble > 9) ? 'a' - 10 + nibble : '0' + nibble);
-				key += tmp;
-				if (i < int_inputs[0]) {
-					key += ":";
-				}
+	if (dev_cfg.exists("block_rates")) {
+		JSON& rates_cfg = dev_cfg["block_rates"];
+		Array<String> keys = rates_cfg.get_object().getkeys();
+		for (int64_t i = 0; i <= keys.max; i++) {
+			try {
+				int rate = Bus::parse_rate(keys[i]);
+				String tmp = rates_cfg[keys[i]].get_numstr();
+				mb.set_rate_interval(dev.address, rate, tmp.getd());
+			} catch (...) {
+				syslog(LOG_ERR, "%s: invalid block rate %s", dev.maintopic.c_str(), keys[i].c_str());
 			}
-			mqtt_data["key"] = key;
 		}
 	}
-}
-
-void
-rs485_rfid125(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 11);
-		if (int_inputs[0] != 0) {
-			String key;
-			String tmp;
-			uint8_t nibble;
-			for (int i = 1; i <= int_inputs[0]; i++) {
-				nibble = (int_inputs[i] >> 4) & 0x0f;
-				tmp.printf("%c", (nibble > 9) ? 'a' - 10 + nibble : '0' + nibble);
-				key += tmp;
-				nibble = int_inputs[i] & 0x0f;
-				tmp.printf("%c", (nibble > 9) ? 'a' - 10 + nibble : '0' + nibble);
-				key += tmp;
-				if (i < int_inputs[0]) {
-					key += ":";
-				}
+	if (dev_cfg.exists("blocks")) {
+		JSON& blocks_cfg = dev_cfg["blocks"];
+		Array<String> keys = blocks_cfg.get_object().getkeys();
+		for (int64_t i = 0; i <= keys.max; i++) {
+			try {
+				String rate = blocks_cfg[keys[i]];
+				mb.set_block_rate(dev.address, keys[i], Bus::parse_rate(rate));
+			} catch (...) {
+				syslog(LOG_ERR, "%s: invalid block setting %s", dev.maintopic.c_str(), keys[i].c_str());
 			}
-			mqtt_data["key"] = key;
-		}
-	}
-}
-
-void
-rs485_thermocouple(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		auto bin_inputs = mb.read_discrete_inputs(address, 0, 24);
-		auto int_inputs = mb.read_input_registers(address, 0, 16);
-		Array<JSON> sensors;
-		for (int i = 0; i < 8; i++) {
-			AArray<JSON> sensor;
-
-			sensor["open_error"] = bin_inputs[i * 3];
-			sensor["gnd_short"] = bin_inputs[i * 3 + 1];
-			sensor["vcc_short"] = bin_inputs[i * 3 + 2];
-			sensor["temperature"].set_number(d_to_s(((double)(int16_t)int_inputs[i * 2]) / 4.0, 2));
-			sensor["cold_temperature"].set_number(d_to_s(((double)(int16_t)int_inputs[ i * 2 + 1]) / 16.0, 2));
-			sensors[i] = sensor;
-		}
-		mqtt_data["thermocouple"] = sensors;
-	}
-}
-
-void
-rs485_ina226(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 4);
-		Array<JSON> sensors;
-
-		{
-			AArray<JSON> sensor;
-
-			double tmpd;
-			int32_t tmp;
-
-			tmp = int_inputs[0] | (int_inputs[1] << 16);
-			tmpd = (double)tmp / 1.25 / 1000;
-			sensor["voltage"].set_number(d_to_s(tmpd, 6));
-
-			tmp = int_inputs[2] | (int_inputs[3] << 16);
-			tmpd = (double)tmp / 2.5 / 1000.0 / 1000.0;
-			sensor["shunt_voltage"].set_number(d_to_s(tmpd, 6));
-			sensors[0] = sensor;
 		}
-		mqtt_data["shunts"] = sensors;
 	}
 }
 
 void
-rs485_valve(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
+device_identify(Bus& mb, Device& dev)
 {
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "speed") {
-					uint16_t val = json[key].get_numstr().getll();
-					mb.write_register(address, 0, val);
-				}
-				if (key == "position") {
-					double val = json[key].get_numstr().getd();
-					mb.write_register(address, 1, (int16_t)(val * 100.0));
-				}
-			}
-		}
-	}
-
-	{
-		auto val = mb.read_holding_registers(address, 0, 2);
-
-		mqtt_data["speed"].set_number((uint64_t)val[0]);
+	JSON& dev_cfg = *dev.cfg;
 
-		double tmpd;
-		tmpd = ((double)(int16_t)val[1]) / 100.0;
-		mqtt_data["position"].set_number(d_to_s(tmpd, 2));
+	String vendor;
+	if (dev_cfg.exists("vendor")) {
+		String tmp = dev_cfg["vendor"];
+		vendor = tmp;
+	} else {
+		vendor = mb.identification(dev.address, 0);
 	}
-
-	{
-		auto val = mb.read_input_registers(address, 0, 6);
-
-		double tmpd;
-		tmpd = ((double)(int16_t)val[0]) / 100.0;
-		mqtt_data["sensor_position"].set_number(d_to_s(tmpd, 2));
-
-		tmpd = ((double)(int16_t)val[4]) * 3.3 / 32768;
-		tmpd = 27.0 - (tmpd - 0.706) / 0.001721;;
-		mqtt_data["temperature"].set_number(d_to_s(tmpd, 2));
+	String product;
+	if (dev_cfg.exists("product")) {
+		String tmp = dev_cfg["product"];
+		product = tmp;
+	} else {
+		product = mb.identification(dev.address, 1);
 	}
-}
-
-void
-rs485_chamberpump(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "triggerlevel_top") {
-					uint16_t val = json[key].get_numstr().getll();
-					mb.write_register(address, 0, val);
-				}
-				if (key == "triggerlevel_bottom") {
-					uint16_t val = json[key].get_numstr().getll();
-					mb.write_register(address, 1, val);
-				}
-				if (key == "start_trigger") {
-					bool val = json[key];
-					mb.write_coil(address, 1, val);
-				}
-				if (key == "auto_start") {
-					bool val = json[key];
-					mb.write_coil(address, 0, val);
-				}
-			}
+	devfunction handler = NULL;
+	if (!product.empty() && !vendor.empty()) {
+		if (!devfunctions.exists(vendor) || !devfunctions[vendor].exists(product)) {
+			throw(Error(S + "unknown product " + vendor + " " + product));
 		}
+		handler = devfunctions[vendor][product];
+	}
+	String version;
+	if (dev_cfg.exists("version")) {
+		String tmp = dev_cfg["version"];
+		version = tmp;
+	} else {
+		version = mb.identification(dev.address, 2);
 	}
 
+	// at this stage we know the device and can handle incoming data
+	dev.vendor = vendor;
+	dev.product = product;
+	dev.version = version;
+	dev.handler = handler;
 	{
-		auto int_inputs = mb.read_input_registers(address, 0, 9);
-		{
-			Array<JSON> adc;
-			adc[0].set_number(S + int_inputs[0]);
-			adc[1].set_number(S + int_inputs[1]);
-			adc[2].set_number(S + int_inputs[2]);
-			adc[3].set_number(S + int_inputs[3]);
-			mqtt_data["adc"] = adc;
-		}
-		{
-			String state;
-			switch(int_inputs[4]) {
-			case 0:
-				state = "idle";
-				break;
-			case 1:
-				state = "filling";
-				break;
-			case 2:
-				state = "full";
-				break;
-			case 3:
-				state = "emptying";
-				break;
-			case 4:
-				state = "empty";
-				break;
-			case 5:
-				state = "unknown";
-			}
-			mqtt_data["state"] = state;
-			mqtt_data["statenum"].set_number(S + int_inputs[4]);
-		}
-		{
-			uint32_t tmp = (uint32_t)int_inputs[5] | (uint32_t)int_inputs[6] << 16;
-			mqtt_data["cyclecounter"].set_number(S + tmp);
-		}
-		{
-			uint32_t tmp = (uint32_t)int_inputs[7] | (uint32_t)int_inputs[8] << 16;
-			mqtt_data["cycletime"].set_number(S + tmp);
+		Array<String> v = version.split(".");
+		if (v.max >= 0) {
+			dev.major = v[0].getll();
 		}
-	}
-}
-
-void
-rs485_conductive_level(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "output") {
-					Array<JSON>& output = json[key].get_array();
-					for (int64_t x = 0; x <= output.max && x < 4; x++) {
-						if (output[x].is_boolean()) {
-							bool val = output[x];
-							mb.write_coil(address, x, val);
-						}
-					}
-				}
-			}
+		if (v.max >= 1) {
+			dev.minor = v[1].getll();
 		}
 	}
-
-	{
-		auto int_inputs = mb.read_input_registers(address, 0, 4);
-		{
-			Array<JSON> adc;
-			adc[0].set_number(S + int_inputs[0]);
-			adc[1].set_number(S + int_inputs[1]);
-			adc[2].set_number(S + int_inputs[2]);
-			adc[3].set_number(S + int_inputs[3]);
-			mqtt_data["adc"] = adc;
+	if (dev.priority < 0) {
+		dev.priority = BusScheduler::PRIO_TELEMETRY;
+		if (devpriorities.exists(vendor) && devpriorities[vendor].exists(product)) {
+			dev.priority = devpriorities[vendor][product];
 		}
 	}
-
-	{
-		auto bin_coils = mb.read_coils(address, 0, 4);
-
-		Array<JSON> outputs;
-		for (int i = 0; i < 4; i++) {
-			outputs[i] = bin_coils[i];
+	if (handler != NULL) {
+		// only suscribe, if we have a handler function
+		dev.mqtt.subscribe(dev.cmd_topic);
+		if (dev.history.enabled()) {
+			dev.mqtt.subscribe(dev.history_topic);
 		}
-		mqtt_data["output"] = outputs;
-	}
-}
-
-void
-trucki_sun1000(Modbus& mb, Array<MQTT::RXbuf>& rxbuf, JSON& mqtt_data, uint8_t address, const String& maintopic, AArray<String>& devdata, JSON& dev_cfg)
-{
-	for (int64_t i = 0; i <= rxbuf.max; i++) {
-		if (rxbuf[i].topic == maintopic + "/cmd") {
-			JSON json;
-			json.parse(rxbuf[i].message);
-			Array<String> keys = json.get_object().getkeys();
-			for (int64_t j = 0; j <= keys.max; j++) {
-				String key = keys[j];
-				if (key == "set power") {
-					if (json[key].is_number()) {
-						double tmp = json[key].get_numstr().getd();
-						tmp = tmp * 10.0;
-						uint16_t val = tmp;
-						mb.write_register(address, 0, val);
-					}
-				}
-			}
+		if (dev.track_counters && devcounters.exists(vendor) && devcounters[vendor].exists(product)) {
+			dev.counterspecs = devcounters[vendor][product];
 		}
 	}
-
-	{
-		auto int_inputs = mb.read_holding_registers(address, 0, 8);
-		mqtt_data["set power"].set_number(d_to_s((double)int_inputs[0] / 10.0, 1));
-		mqtt_data["output power"].set_number(d_to_s((double)int_inputs[1] / 10.0, 1));
-		mqtt_data["grid voltage"].set_number(d_to_s((double)int_inputs[2] / 10.0, 1));
-		mqtt_data["battery voltage"].set_number(d_to_s((double)int_inputs[3] / 10.0, 1));
-		mqtt_data["DAC value"].set_number(d_to_s((double)int_inputs[4], 0));
-		mqtt_data["temperature"].set_number(d_to_s((double)int_inputs[7], 0));
-	}
+	dev.identified = true;
 }
 
 void*
 ModbusLoop(void * arg)
 {
-	Array<AArray<String>> devdata;
 	int64_t bus = *(int64_t*)arg;
 	delete (int64_t*)arg;
 
@@ -1539,159 +475,268 @@ ModbusLoop(void * arg)
 	String port = bus_cfg["port"];
 	String threadname = String() + "mb[" + host + "]@" + port;
 	pthread_setname_np(pthread_self(), threadname.c_str());
-	Modbus mb(host, port);
+	trace_thread(threadname);
+	Bus mb(host, port);
+	bool realtime = bus_cfg.exists("realtime");
+	if (realtime) {
+		realtime_setup(bus_cfg["realtime"], threadname);
+	}
 	if (bus_cfg.exists("ignore_sequence")) {
 		bool ignore_sequence;
 		ignore_sequence = bus_cfg["ignore_sequence"];
 		mb.set_ignore_sequence(ignore_sequence);
 	}
+	if (bus_cfg.exists("retries")) {
+		mb.set_retries(bus_cfg["retries"].get_numstr().getll());
+	}
+	// the temporaries of each poll come from a per thread arena,
+	// realtime buses don't use the heap once warmed up
+	bool use_arena = realtime;
+	if (bus_cfg.exists("arena")) {
+		use_arena = bus_cfg["arena"];
+	}
+
+	// with MQTTv5 the poll time can be sent as user property instead
+	bool timestamp_property = false;
+	if (cfg["mqtt"].exists("protocol") && cfg["mqtt"]["protocol"].get_numstr().getll() == 5 &&
+	    cfg["mqtt"].exists("timestamp_property")) {
+		timestamp_property = cfg["mqtt"]["timestamp_property"];
+	}
 
-	Array<MQTT> dev_mqtts;
-	Array<struct timespec> lasttime;
+	// worker jobs keep pointers to the devices, so create all of them upfront
+	Array<Device> devices;
+	int64_t maxdev = bus_cfg["devices"].get_array().max;
+	for (int64_t i = 0; i <= maxdev; i++) {
+		Device& dev = devices[i];
+		device_setup(dev, bus_cfg["devices"][i], cfg["mqtt"], host, port);
+		dev.poolkey = ((uint64_t)bus << 16) + i;
+		dev.arena = use_arena;
+		if (dev.write_cache) {
+			mb.set_write_cache(dev.address, dev.write_cache_verify);
+		}
+		device_blocks(mb, dev);
+	}
 
-	for (int64_t dev = 0; dev <= bus_cfg["devices"].get_array().max; dev++) {
-		clock_gettime(CLOCK_MONOTONIC, &lasttime[dev]);
+	BusScheduler sched;
+	Array<int> due;
+	String bustopic = S + main_mqtt.maintopic + "/bus/" + host + "/" + port;
+	BusSnapshot snapshot;
+	time_t last_tick = 0;
+	if (bus_cfg.exists("snapshot")) {
+		snapshot.setup(bus_cfg["snapshot"], bustopic + "/snapshot", maxdev + 1);
+	}
+	ModbusProxy proxy;
+	if (bus_cfg.exists("proxy")) {
+		try {
+			proxy.setup(bus_cfg["proxy"], threadname);
+			proxy.start();
+		} catch (...) {
+			syslog(LOG_ERR, "%s: failed to start Modbus/TCP proxy", threadname.c_str());
+		}
 	}
 
 	for(;;) {
 		struct timespec now;
 		clock_gettime(CLOCK_MONOTONIC, &now);
 
-		for (int64_t dev = 0; dev <= bus_cfg["devices"].get_array().max; dev++) {
-			JSON& dev_cfg = bus_cfg["devices"][dev];
-			JSON mqtt_data;
-			{
-				AArray<JSON> tmp;
-				mqtt_data = tmp;
+		{
+			double t = (double)now.tv_sec + (double)now.tv_nsec / 1000000000;
+			JSON report;
+			if (sched.report(t, mb.busy_time(), report)) {
+				main_mqtt.publish(bustopic, report.generate(), false);
 			}
-			int qos = 0;
-			if (dev_cfg.exists("qos")) {
-				qos = dev_cfg["qos"].get_numstr().getll();
+			if (snapshot.enabled()) {
+				snapshot.flush(t, main_mqtt);
 			}
+		}
 
-			String maintopic = dev_cfg["maintopic"];
-			uint8_t address = dev_cfg["address"].get_numstr().getll();
-			if (!dev_mqtts.exists(dev)) {
-				MQTT& mqtt = dev_mqtts[dev];
-				JSON& mqtt_cfg = cfg["mqtt"];
-				String id = mqtt_cfg["id"];
-				if (!id.empty()) {
-					id += S + "[" + host + "]" + port + "/" + address;
+		// aggregation windows also end without a successful poll
+		{
+			struct timespec wall;
+			clock_gettime(CLOCK_REALTIME_FAST, &wall);
+			if (wall.tv_sec != last_tick) {
+				last_tick = wall.tv_sec;
+				for (int64_t i = 0; i <= maxdev; i++) {
+					Device& dev = devices[i];
+					if (dev.aggregator.enabled()) {
+						dev.aggregator.tick(wall, dev.mqtt, dev.maintopic, dev.qos);
+					}
 				}
-				mqtt.id = id;
-				String host = mqtt_cfg["host"];
-				mqtt.host = host;
-				String port = mqtt_cfg["port"];
-				mqtt.port = port.getll();
-				String username = mqtt_cfg["username"];
-				mqtt.username = username;
-				String password = mqtt_cfg["password"];
-				mqtt.password = password;
-				mqtt.maintopic = maintopic;
-				mqtt.rxbuf_enable = true;
-				mqtt.connect();
-			};
-			MQTT& mqtt = dev_mqtts[dev];
+			}
+		}
+
+		// proxy requests are interleaved with the device polls
+		if (proxy.enabled()) {
+			proxy.process(mb, 8);
+		}
+
+		// pick one due device at a time, so a bulk device can't
+		// block the others for a whole round
+		for (int64_t i = 0; i <= maxdev; i++) {
+			Device& dev = devices[i];
+			due[i] = -1;
+			if (!dev.identified) {
+				due[i] = (dev.priority < 0) ? (int)BusScheduler::PRIO_TELEMETRY : dev.priority;
+				continue;
+			}
+			// with the write cache a command is answered right away
+			if (dev.write_cache && dev.mqtt.rx_pending()) {
+				due[i] = BusScheduler::PRIO_COMMAND;
+				continue;
+			}
+			struct timespec timespecdiff;
+			timespecsub(&now, &dev.lasttime, &timespecdiff);
+			double timediff = (double)(timespecdiff.tv_sec) + (double)(timespecdiff.tv_nsec) / 1000000000;
+			if (timediff >= dev.interval) {
+				due[i] = dev.priority;
+			}
+		}
+		int64_t i = sched.select(due);
+		if (i < 0) {
+			bool woken = false;
+			struct timespec asleep;
+			clock_gettime(CLOCK_MONOTONIC, &asleep);
+			if (proxy.enabled()) {
+				woken = proxy.wait(0.01);
+			} else {
+				usleep(10000); // sleep 10ms
+			}
+			// requests woke us early, that's no latency
+			if (realtime && !woken) {
+				struct timespec awake;
+				clock_gettime(CLOCK_MONOTONIC, &awake);
+				struct timespec timespecdiff;
+				timespecsub(&awake, &asleep, &timespecdiff);
+				double slept = (double)(timespecdiff.tv_sec) + (double)(timespecdiff.tv_nsec) / 1000000000;
+				sched.wakeup_latency(slept - 0.01);
+			}
+			continue;
+		}
+
+		{
+			ArenaScope arena_scope(use_arena);
+			Device& dev = devices[i];
+			MQTT& mqtt = dev.mqtt;
+			double busy = mb.busy_time();
+#ifdef ALLOC_STATS
+			uint64_t allocations = alloc_count();
+#endif
+			Array<MQTT::RXbuf> rxbuf;
+			bool fetched = false;
 			try {
-				if (!devdata[dev].exists("vendor")) {
-					String vendor;
-					if (dev_cfg.exists("vendor")) {
-						String tmp = dev_cfg["vendor"];
-						vendor = tmp;
-					} else {
-						vendor = mb.identification(address, 0);
-					}
-					devdata[dev]["vendor"] = vendor;
+				TraceSpan poll_span("poll");
+				if (!dev.identified) {
+					device_identify(mb, dev);
 				}
-				String vendor = devdata[dev]["vendor"];
-				if (!devdata[dev].exists("product")) {
-					String product;
-					if (dev_cfg.exists("product")) {
-						String tmp = dev_cfg["product"];
-						product = tmp;
-					} else {
-						product = mb.identification(address, 1);
-					}
-					devdata[dev]["product"] = product;
+
+				JSON mqtt_data;
+				{
+					AArray<JSON> tmp;
+					mqtt_data = tmp;
 				}
-				String product = devdata[dev]["product"];
-				if (!product.empty() && !vendor.empty()) {
-					if (!devfunctions.exists(vendor) || !devfunctions[vendor].exists(product)) {
-						throw(Error(S + "unknown product " + vendor + " " + product));
+				mqtt_data["vendor"] = dev.vendor;
+				mqtt_data["product"] = dev.product;
+				mqtt_data["version"] = dev.version;
+				if (dev.handler != NULL) {
+					TraceSpan handler_span("handler");
+					rxbuf = mqtt.get_rxbuf();
+					fetched = true;
+					mb.begin_poll();
+					(*dev.handler)(mb, rxbuf, mqtt_data, dev.address, dev, *dev.cfg);
+					if (mb.poll_failed()) {
+						throw(Error(S + "no response from " + dev.maintopic));
 					}
+					mb.error_counters(dev.address, mqtt_data);
+					mb.block_timestamps(dev.address, mqtt_data);
 				}
-				if (!devdata[dev].exists("version")) {
-					String version;
-					if (dev_cfg.exists("version")) {
-						String tmp = dev_cfg["version"];
-						version = tmp;
+				String timestamp;
+				struct timespec tp;
+				clock_gettime(CLOCK_REALTIME_FAST, &tp);
+				{
+					const String& date_str = clock_string(tp.tv_sec);
+					if (timestamp_property) {
+						timestamp = date_str;
 					} else {
-						version = mb.identification(address, 2);
+						mqtt_data["time"] = date_str;
 					}
-					devdata[dev]["version"] = version;
 				}
-				if (devdata[dev]["maintopic"].empty()) {
-					// at this stage we know the device and can handle incoming data
-					devdata[dev]["maintopic"] = maintopic;
-					String product = devdata[dev]["product"];
-					if (!product.empty()) {
-						// only suscribe, if we have a handler function
-						mqtt.subscribe(maintopic + "/cmd");
-					}
+				if (dev.counterspecs.max >= 0) {
+					double t = (double)tp.tv_sec + (double)tp.tv_nsec / 1000000000;
+					track_counters(mqtt_data, dev.counterspecs, dev.counterslots, *dev.counters, t);
 				}
-				bool poll = true;
-				double intervall = 1.0;
-				if (dev_cfg.exists("min_pollintervall")) {
-					String tmp = dev_cfg["min_pollintervall"].get_numstr();
-					intervall = (double)tmp.getd();
+				if (dev.aggregator.enabled()) {
+					dev.aggregator.update(mqtt_data, tp, mqtt, dev.maintopic, dev.qos);
 				}
-				struct timespec timespecdiff;
-				timespecsub(&now, &lasttime[dev], &timespecdiff);
-				double timediff = (double)(timespecdiff.tv_sec) + (double)(timespecdiff.tv_nsec) / 1000000000;
-				if (timediff < intervall) {
-					poll = false;
+				if (dev.history.enabled()) {
+					dev.history.update(mqtt_data, tp);
 				}
-				if (poll) {
-					if (devdata[dev].exists("vendor")) {
-						mqtt_data["vendor"] = devdata[dev]["vendor"];
-					}
-					if (devdata[dev].exists("product")) {
-						mqtt_data["product"] = devdata[dev]["product"];
-					}
-					if (devdata[dev].exists("version")) {
-						mqtt_data["version"] = devdata[dev]["version"];
-					}
-					if (!product.empty() && !vendor.empty()) {
-						auto rxbuf = mqtt.get_rxbuf();
-						(*devfunctions[vendor][product])(mb, rxbuf, mqtt_data, address, maintopic, devdata[dev], dev_cfg);
-					}
-					{
-						struct timespec tp;
-						clock_gettime(CLOCK_REALTIME_FAST, &tp);
-						time_t uts_time = tp.tv_sec;
-						String date_str;
-						{
-							a_ptr<char> buf;
-							buf = new char[256];
-
-							struct tm stm;
-							localtime_r(&uts_time, &stm);
-							strftime(buf.get(), 256 - 1, "%Y-%m-%dT%H:%M:%S%z", &stm);
-							date_str = buf.get();
-						}
-						mqtt_data["time"] = date_str;
-					}
-					mqtt.publish(maintopic + "/data", mqtt_data.generate(), false, false, qos);
-					mqtt.publish(maintopic + "/status", "online", false, false, qos);
-					lasttime[dev] = now;
+				WorkerPool::Job job;
+				job.dev = &dev;
+				job.timestamp = timestamp;
+				job.status = "online";
+				job.has_data = true;
+#ifdef ALLOC_STATS
+				mqtt_data["allocations"].set_number(S + (alloc_count() - allocations));
+#endif
+				if (snapshot.enabled()) {
+					snapshot.update(i, dev.maintopic, job.status, &mqtt_data);
+				}
+				if (mbserver.enabled()) {
+					mbserver.update(dev.maintopic, mqtt_data);
+				}
+				std::swap(job.data, mqtt_data);
+				if (!snapshot.suppress_devices()) {
+					pool.submit(dev.poolkey, job);
 				}
+				dev.lasttime = now;
 			} catch(...) {
-				mqtt.publish(maintopic + "/status", "offline", false, false, qos);
+				WorkerPool::Job job;
+				job.dev = &dev;
+				job.status = "offline";
+				job.has_data = false;
+				if (snapshot.enabled()) {
+					snapshot.update(i, dev.maintopic, job.status, NULL);
+				}
+				if (mbserver.enabled()) {
+					mbserver.invalidate(dev.maintopic);
+				}
+				if (!snapshot.suppress_devices()) {
+					pool.submit(dev.poolkey, job);
+				}
+				mb.invalidate(dev.address);
 				sleep(1);
 			}
+			// answered outside of the poll, commands can't be executed by an
+			// offline device anyway
+			if (!fetched && dev.handler != NULL && dev.history.enabled()) {
+				rxbuf = mqtt.get_rxbuf();
+			}
+			history_queries(dev, rxbuf);
+			sched.account(i, due[i], mb.busy_time() - busy);
 		}
+	}
+
+	return NULL;
+}
 
-		usleep(10000); // sleep 10ms
+void*
+SpoolLoop(void * arg)
+{
+	pthread_setname_np(pthread_self(), "spool");
+	trace_thread("spool");
+
+	for (;;) {
+		Spool::Entry entry;
+		if (!main_mqtt.is_connected() || !spool.peek(entry)) {
+			sleep(1);
+			continue;
+		}
+		if (main_mqtt.publish_raw(entry.topic, entry.message.data(), entry.message.length(), entry.retain, entry.qos, entry.timestamp)) {
+			spool.pop(entry);
+		} else {
+			sleep(1);
+		}
+		usleep(1000000 / spool_rate);
 	}
 
 	return NULL;
@@ -1704,10 +749,23 @@ main(int argc, char *argv[]) {
 
 	openlog(argv[0], LOG_PID, LOG_LOCAL0);
 
+	// the supervisor starts its workers from the same binary
+	String program = argv[0];
+	if (strchr(argv[0], '/') != NULL) {
+		char path[PATH_MAX];
+		if (realpath(argv[0], path) != NULL) {
+			program = path;
+		}
+	}
+
 	int ch;
 	bool debug = false;
+	int64_t shard = -1;
+	String scanfile;
+	String infodir = "/usr/local/share/mb_mqttbridge/info";
+	int scan_concurrency = 4;
 
-	while ((ch = getopt(argc, argv, "c:dp:")) != -1) {
+	while ((ch = getopt(argc, argv, "c:di:j:p:s:S:")) != -1) {
 		switch (ch) {
 		case 'c':
 			configfile = optarg;
@@ -1715,9 +773,24 @@ main(int argc, char *argv[]) {
 		case 'd':
 			debug = true;
 			break;
+		case 'i':
+			infodir = optarg;
+			break;
+		case 'j':
+			scan_concurrency = atoi(optarg);
+			break;
 		case 'p':
 			pidfile = optarg;
 			break;
+		case 's':
+			scanfile = optarg;
+			debug = true;
+			break;
+		case 'S':
+			// worker process started by the supervisor
+			shard = atoll(optarg);
+			debug = true;
+			break;
 		case '?':
 			default:
 			usage();
@@ -1731,7 +804,7 @@ main(int argc, char *argv[]) {
 	}
 
 	// write pidfile
-	{
+	if (scanfile.empty() && shard < 0) {
 		pid_t pid;
 		pid = getpid();
 		File pfile;
@@ -1748,30 +821,89 @@ main(int argc, char *argv[]) {
 		config->parse(json);
 	}
 
+	// register devicefunctions
+	register_handlers(devfunctions);
+
+	if (!scanfile.empty()) {
+		if (!config->exists("modbuses")) {
+			printf("no modbus setup in config\n");
+			exit(1);
+		}
+		discover(*config, devfunctions, infodir, scanfile, scan_concurrency);
+		exit(0);
+	}
+
 	mosquitto_lib_init();
 
 	a_refptr<JSON> my_config = config;
 	JSON& cfg = *my_config.get();
 
+	if (cfg.exists("trace")) {
+		JSON& trace_cfg = cfg["trace"];
+		String file = "/tmp/mb_mqttbridge.trace.json";
+		if (trace_cfg.exists("file")) {
+			String tmp = trace_cfg["file"];
+			file = tmp;
+		}
+		if (shard >= 0) {
+			file += S + "." + shard;
+		}
+		bool enabled = false;
+		if (trace_cfg.exists("enabled")) {
+			enabled = trace_cfg["enabled"];
+		}
+		trace_setup(file, enabled);
+	}
+
+	bool supervisor = (cfg.exists("supervisor") && shard < 0);
+	// every worker process gets its own files and topics
+	String shardsuffix;
+	if (shard >= 0) {
+		shardsuffix = S + "." + shard;
+	}
+
 	if (cfg.exists("mqtt")) {
 		JSON& mqtt_cfg = cfg["mqtt"];
+		if (mqtt_cfg.exists("spool") && !supervisor) {
+			JSON& spool_cfg = mqtt_cfg["spool"];
+			String file = spool_cfg["file"];
+			file += shardsuffix;
+			uint64_t size = 16 * 1024 * 1024;
+			if (spool_cfg.exists("size")) {
+				size = spool_cfg["size"].get_numstr().getll();
+			}
+			if (spool_cfg.exists("rate")) {
+				spool_rate = spool_cfg["rate"].get_numstr().getll();
+				if (spool_rate < 1) {
+					spool_rate = 1;
+				}
+			}
+			try {
+				spool.open(file, size);
+			} catch (...) {
+				printf("failed to setup spool %s\n", file.c_str());
+				exit(1);
+			}
+		}
 		String id = mqtt_cfg["id"];
-		main_mqtt.id = id;
-		String host = mqtt_cfg["host"];
-		main_mqtt.host = host;
-		String port = mqtt_cfg["port"];
-		main_mqtt.port = port.getll();
-		String username = mqtt_cfg["username"];
-		main_mqtt.username = username;
-		String password = mqtt_cfg["password"];
-		main_mqtt.password = password;
 		String maintopic = mqtt_cfg["maintopic"];
+		if (shard >= 0) {
+			if (!id.empty()) {
+				id += S + "/shard" + shard;
+			}
+			maintopic += S + "/shard/" + shard;
+		}
+		main_mqtt.id = id;
+		mqtt_setup(main_mqtt, mqtt_cfg);
 		main_mqtt.maintopic = maintopic;
-		main_mqtt.rxbuf_enable = true;
-		main_mqtt.autoonline = true;
+		// the supervisor publishes the aggregated worker status instead
+		main_mqtt.rxbuf_enable = !supervisor;
+		main_mqtt.autoonline = !supervisor;
 		main_mqtt.connect();
-		String willtopic = maintopic + "/status";
-		main_mqtt.publish(willtopic, "online", true);
+		if (!supervisor) {
+			String willtopic = maintopic + "/status";
+			main_mqtt.publish(willtopic, "online", true);
+		}
 		JSON mqtt_data;
 		{
 			AArray<JSON> tmp;
@@ -1790,45 +922,88 @@ main(int argc, char *argv[]) {
 		exit(1);
 	}
 
-	// register devicefunctions
-	devfunctions["Bernd Walter Computer Technology"]["Ethernet-MB twin power relay / 4ch input"] = eth_tpr;
-	devfunctions["Bernd Walter Computer Technology"]["Ethernet-MB RS485 / twin power relay / 4ch input / LDR / DS18B20"] = eth_tpr_ldr;
-	devfunctions["Bernd Walter Computer Technology"]["MB 3x jalousie actor / 8ch input"] = rs485_jalousie;
-	devfunctions["Bernd Walter Computer Technology"]["MB 6x power relay / 8ch input"] = rs485_relais6;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-SHTC3"] = rs485_shtc3;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-Laserdistance-Weight"] = rs485_laserdistance;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-IO88"] = rs485_io88;
-	devfunctions["Bernd Walter Computer Technology"]["ETH-IO88"] = eth_io88;
-	devfunctions["Bernd Walter Computer Technology"]["ETH-IO88F"] = eth_io88;
-	devfunctions["Bernd Walter Computer Technology"]["ETH-IO88P"] = eth_io88p;
-	devfunctions["Bernd Walter Computer Technology"]["ETH-IO88FP"] = eth_io88p;
-	devfunctions["Bernd Walter Computer Technology"]["MB ADC DAC"] = rs485_adc_dac;
-	devfunctions["Bernd Walter Computer Technology"]["MB ADC DAC-30"] = rs485_adc_dac_30;
-	devfunctions["Bernd Walter Computer Technology"]["125kHz RFID Reader / Display"] = rs485_rfid125_disp;
-	devfunctions["Bernd Walter Computer Technology"]["125kHz RFID Reader / Writer-Beta"] = rs485_rfid125;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-TCK"] = rs485_thermocouple;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-Chamberpump"] = rs485_chamberpump;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-conductive-level"] = rs485_conductive_level;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-INA226"] = rs485_ina226;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-Valve"] = rs485_valve;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-ADC-DAC-2"] = rs485_adc_dac_2;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-ADCP-DAC-2"] = rs485_adcp_dac_2;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-ADCC-DAC-2"] = rs485_adcc_dac_2;
-	devfunctions["Bernd Walter Computer Technology"]["RS485-ADCCP-DAC-2"] = rs485_adccp_dac_2;
-	devfunctions["Bernd Walter Computer Technology"]["ETH-MULTI-RS485"] = empty;
-	devfunctions["Epever"]["Triron"] = Epever_Triron;
-	devfunctions["Epever"]["Tracer"] = Epever_Triron;
-	devfunctions["Shanghai Chujin Electric"]["Panel Powermeter"] = ZGEJ_powermeter;
-	devfunctions["Eastron"]["SDM220"] = eastron_sdm220;
-	devfunctions["Eastron"]["SDM630"] = eastron_sdm630;
-	devfunctions["Eastron"]["SDM72"] = eastron_sdm630;
-	devfunctions["MRU"]["SWG100"] = mru_swg100;
-	devfunctions["Trucki"]["SUN1000"] = trucki_sun1000;
-	devfunctions["Trucki"]["SUN2000"] = trucki_sun1000;
+	if (supervisor) {
+		Supervisor sv(program, configfile);
+		sv.run(cfg, main_mqtt);
+	}
+
+	// register default priority classes, everything else is telemetry
+	devpriorities["Bernd Walter Computer Technology"]["RS485-IO88"] = BusScheduler::PRIO_FAST;
+	devpriorities["Bernd Walter Computer Technology"]["ETH-IO88"] = BusScheduler::PRIO_FAST;
+	devpriorities["Bernd Walter Computer Technology"]["ETH-IO88F"] = BusScheduler::PRIO_FAST;
+	devpriorities["Bernd Walter Computer Technology"]["ETH-IO88P"] = BusScheduler::PRIO_FAST;
+	devpriorities["Bernd Walter Computer Technology"]["ETH-IO88FP"] = BusScheduler::PRIO_FAST;
+	devpriorities["MRU"]["SWG100"] = BusScheduler::PRIO_BULK;
+
+	// register counters, which get tracked for rollover and restarts
+	devcounters["Bernd Walter Computer Technology"]["Ethernet-MB RS485 / twin power relay / 4ch input / LDR / DS18B20"] << counter_spec("counters", 0, 4, 16);
+	devcounters["Bernd Walter Computer Technology"]["Ethernet-MB RS485 / twin power relay / 4ch input / LDR / DS18B20"] << counter_spec("counters", 4, 4, 32);
+	devcounters["Bernd Walter Computer Technology"]["ETH-IO88"] << counter_spec("counter", 0, 8, 64);
+	devcounters["Bernd Walter Computer Technology"]["ETH-IO88F"] << counter_spec("counter", 0, 8, 64);
+	devcounters["Bernd Walter Computer Technology"]["ETH-IO88P"] << counter_spec("counter", 0, 8, 64);
+	devcounters["Bernd Walter Computer Technology"]["ETH-IO88FP"] << counter_spec("counter", 0, 8, 64);
+	devcounters["Bernd Walter Computer Technology"]["RS485-Chamberpump"] << counter_spec("cyclecounter", -1, 1, 32);
+
+	{
+		String statefile = "/var/db/mb_mqttbridge.counters";
+		if (cfg.exists("counter_state")) {
+			String tmp = cfg["counter_state"];
+			statefile = tmp;
+		}
+		statefile += shardsuffix;
+		counters.load(statefile);
+	}
+	if (cfg.exists("compress_dictionaries")) {
+		String tmp = cfg["compress_dictionaries"];
+		zdictdir = tmp;
+	}
+
+	{
+		int64_t threads = 0;
+		int64_t queuesize = 64;
+		if (cfg.exists("pool")) {
+			JSON& pool_cfg = cfg["pool"];
+			if (pool_cfg.exists("threads")) {
+				threads = pool_cfg["threads"].get_numstr().getll();
+			}
+			if (pool_cfg.exists("queue")) {
+				queuesize = pool_cfg["queue"].get_numstr().getll();
+			}
+		}
+		pool.start(threads, queuesize, publish_job);
+	}
+
+	if (cfg.exists("modbus_server")) {
+		if (shard >= 0) {
+			syslog(LOG_ERR, "modbus_server is not supported with the supervisor");
+		} else {
+			try {
+				mbserver.setup(cfg["modbus_server"]);
+				mbserver.start();
+			} catch (...) {
+				printf("failed to setup modbus server\n");
+				exit(1);
+			}
+		}
+	}
+
+	if (spool.enabled()) {
+		pthread_t spool_thread;
+		pthread_create(&spool_thread, NULL, SpoolLoop, NULL);
+		pthread_detach(spool_thread);
+	}
 
 	// start poll loops
 	JSON& modbuses = cfg["modbuses"];
+	int64_t nshards = (shard >= 0) ? Supervisor::shard_count(cfg) : 0;
 	for (int64_t bus = 0; bus <= modbuses.get_array().max; bus++) {
+		if (shard >= 0) {
+			String host = modbuses[bus]["host"];
+			String port = modbuses[bus]["port"];
+			if (Supervisor::shard_of(S + host + ":" + port, nshards) != shard) {
+				continue;
+			}
+		}
 		int64_t* busno = new(int64_t);
 		*busno = bus;
 		pthread_t modbus_thread;
@@ -1836,8 +1011,14 @@ main(int argc, char *argv[]) {
 		pthread_detach(modbus_thread);
 	}
 
-	for (;;) {
-		sleep(10);
+	for (int64_t i = 1;; i++) {
+		sleep(1);
+		if (trace_dump_requested()) {
+			trace_dump();
+		}
+		if (i % 10 == 0) {
+			counters.save();
+		}
 	}
 	return 0;
 }
@@ -1845,7 +1026,7 @@ main(int argc, char *argv[]) {
 void
 usage(void) {
 
-	printf("usage: mb_mqttbridge [-d] [-c configfile] [-p pidfile]\n");
+	printf("usage: mb_mqttbridge [-d] [-c configfile] [-p pidfile]\n       mb_mqttbridge -s outfile [-c configfile] [-i infodir] [-j probes]\n");
 	exit(1);
 }
 
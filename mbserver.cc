@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "mbserver.h"
+#include "tcp.h"
+#include <sys/socket.h>
+#include <math.h>
+
+#define MB_ILLEGAL_FUNCTION 0x01
+#define MB_ILLEGAL_ADDRESS 0x02
+#define MB_TARGET_FAILED 0x0b
+
+#define REG_KEY(unit, reg) (((uint32_t)(unit) << 16) | (reg))
+
+ModbusServer::ModbusServer()
+{
+	active = false;
+	port = "502";
+}
+
+void
+ModbusServer::setup(JSON& cfg)
+{
+	// {"listen": "::", "port": 502, "map": [{"unit": 1, "register": 0,
+	// "topic": "<device maintopic>", "field": "...", "type": "float32", "scale": 1}]}
+	if (cfg.exists("listen")) {
+		String tmp = cfg["listen"];
+		host = tmp;
+	}
+	if (cfg.exists("port")) {
+		port = cfg["port"].get_numstr();
+	}
+	clients.setup(cfg);
+	Array<JSON>& map = cfg["map"].get_array();
+	for (int64_t i = 0; i <= map.max; i++) {
+		JSON& map_cfg = map[i];
+		Mapping& m = mappings[i];
+		m.unit = map_cfg["unit"].get_numstr().getll();
+		m.reg = map_cfg["register"].get_numstr().getll();
+		String topic = map_cfg["topic"];
+		m.topic = topic;
+		String field = map_cfg["field"];
+		m.field = field;
+		m.type = TYPE_UINT16;
+		if (map_cfg.exists("type")) {
+			String type = map_cfg["type"];
+			if (type == "int16") {
+				m.type = TYPE_INT16;
+			} else if (type == "uint16") {
+				m.type = TYPE_UINT16;
+			} else if (type == "int32") {
+				m.type = TYPE_INT32;
+			} else if (type == "uint32") {
+				m.type = TYPE_UINT32;
+			} else if (type == "float32") {
+				m.type = TYPE_FLOAT32;
+			} else {
+				throw Error(S + "unknown register type " + type);
+			}
+		}
+		m.scale = 1;
+		if (map_cfg.exists("scale")) {
+			String tmp = map_cfg["scale"].get_numstr();
+			m.scale = tmp.getd();
+		}
+		m.valid = false;
+		m.value = 0;
+		int words = (m.type == TYPE_INT16 || m.type == TYPE_UINT16) ? 1 : 2;
+		for (int w = 0; w < words; w++) {
+			Slot& slot = registers[REG_KEY(m.unit, m.reg + w)];
+			slot.mapping = i;
+			slot.word = w;
+		}
+		by_topic[m.topic] << i;
+	}
+	active = true;
+}
+
+bool
+ModbusServer::enabled() const
+{
+	return active;
+}
+
+void
+ModbusServer::update(const String& topic, JSON& data)
+{
+	if (!by_topic.exists(topic)) {
+		return;
+	}
+	Array<int64_t>& list = by_topic[topic];
+	mtx.lock();
+	for (int64_t i = 0; i <= list.max; i++) {
+		Mapping& m = mappings[list[i]];
+		if (data.exists(m.field) && data[m.field].is_number()) {
+			m.value = data[m.field].get_numstr().getd();
+			m.valid = true;
+		}
+	}
+	mtx.unlock();
+}
+
+int64_t
+ModbusServer::clamp(double val, int64_t min, int64_t max, int64_t nan)
+{
+	// out of range values saturate, NaN gets the SunSpec "not
+	// implemented" value of the type, casting either is undefined
+	if (isnan(val)) {
+		return nan;
+	}
+	if (val <= (double)min) {
+		return min;
+	}
+	if (val >= (double)max) {
+		return max;
+	}
+	return (int64_t)val;
+}
+
+void
+ModbusServer::invalidate(const String& topic)
+{
+	// the device is offline, answer with 0x0b instead of stale values
+	if (!by_topic.exists(topic)) {
+		return;
+	}
+	Array<int64_t>& list = by_topic[topic];
+	mtx.lock();
+	for (int64_t i = 0; i <= list.max; i++) {
+		mappings[list[i]].valid = false;
+	}
+	mtx.unlock();
+}
+
+bool
+ModbusServer::read_register(uint8_t unit, uint16_t reg, uint16_t& value, uint8_t& exception)
+{
+	// called with mtx held
+	auto it = registers.find(REG_KEY(unit, reg));
+	if (it == registers.end()) {
+		exception = MB_ILLEGAL_ADDRESS;
+		return false;
+	}
+	Mapping& m = mappings[it->second.mapping];
+	if (!m.valid) {
+		exception = MB_TARGET_FAILED;
+		return false;
+	}
+	double val = m.value * m.scale;
+	uint32_t raw;
+	switch (m.type) {
+	case TYPE_INT16:
+		value = (uint16_t)(int16_t)clamp(val, INT16_MIN, INT16_MAX, INT16_MIN);
+		return true;
+	case TYPE_UINT16:
+		value = (uint16_t)clamp(val, 0, UINT16_MAX, UINT16_MAX);
+		return true;
+	case TYPE_INT32:
+		raw = (uint32_t)(int32_t)clamp(val, INT32_MIN, INT32_MAX, INT32_MIN);
+		break;
+	case TYPE_UINT32:
+		raw = (uint32_t)clamp(val, 0, UINT32_MAX, UINT32_MAX);
+		break;
+	default:
+		{
+			float f = val;
+			memcpy(&raw, &f, sizeof(raw));
+		}
+		break;
+	}
+	// high word first
+	value = (it->second.word == 0) ? (raw >> 16) : (raw & 0xffff);
+	return true;
+}
+
+void
+ModbusServer::client_loop(int fd)
+{
+	uint8_t req[260];
+	uint8_t resp[260];
+	for (;;) {
+		// MBAP header: transaction, protocol, length, unit
+		if (!tcp_read(fd, req, 7)) {
+			break;
+		}
+		uint16_t len = (req[4] << 8) | req[5];
+		if (req[2] != 0 || req[3] != 0 || len < 2 || len > 254) {
+			break;
+		}
+		if (!tcp_read(fd, req + 7, len - 1)) {
+			break;
+		}
+		uint8_t unit = req[6];
+		uint8_t function = req[7];
+		memcpy(resp, req, 7);
+		resp[7] = function;
+		size_t resplen = 0;
+		uint8_t exception = 0;
+		if ((function == 0x03 || function == 0x04) && len == 6) {
+			uint16_t reg = (req[8] << 8) | req[9];
+			uint16_t count = (req[10] << 8) | req[11];
+			// the range must not wrap at the end of the register space
+			if (count < 1 || count > 125 || (uint32_t)reg + count > 0x10000) {
+				exception = MB_ILLEGAL_ADDRESS;
+			} else {
+				mtx.lock();
+				for (uint32_t i = 0; i < count; i++) {
+					uint16_t value;
+					if (!read_register(unit, (uint32_t)reg + i, value, exception)) {
+						break;
+					}
+					resp[9 + i * 2] = value >> 8;
+					resp[10 + i * 2] = value & 0xff;
+				}
+				mtx.unlock();
+				resp[8] = count * 2;
+				resplen = 2 + count * 2;
+			}
+		} else {
+			exception = MB_ILLEGAL_FUNCTION;
+		}
+		if (exception != 0) {
+			resp[7] = function | 0x80;
+			resp[8] = exception;
+			resplen = 2;
+		}
+		resp[4] = (resplen + 1) >> 8;
+		resp[5] = (resplen + 1) & 0xff;
+		if (!tcp_write(fd, resp, 7 + resplen)) {
+			break;
+		}
+	}
+	close(fd);
+	clients.remove();
+}
+
+void*
+ModbusServer::int_client_loop(void *arg)
+{
+	std::pair<ModbusServer*, int> *client = (std::pair<ModbusServer*, int>*)arg;
+	ModbusServer *server = client->first;
+	int fd = client->second;
+	delete client;
+
+	pthread_setname_np(pthread_self(), "mbserver client");
+	server->client_loop(fd);
+	return NULL;
+}
+
+void
+ModbusServer::accept_loop(int fd)
+{
+	for (;;) {
+		int cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			if (errno != EINTR) {
+				syslog(LOG_ERR, "mbserver: accept failed: %s", strerror(errno));
+				sleep(1);
+			}
+			continue;
+		}
+		if (!clients.add(cfd)) {
+			syslog(LOG_WARNING, "mbserver: too many clients, closing connection");
+			close(cfd);
+			continue;
+		}
+		pthread_t thread;
+		auto client = new std::pair<ModbusServer*, int>(this, cfd);
+		if (pthread_create(&thread, NULL, int_client_loop, client) != 0) {
+			delete client;
+			close(cfd);
+			clients.remove();
+			continue;
+		}
+		pthread_detach(thread);
+	}
+}
+
+void*
+ModbusServer::int_accept_loop(void *arg)
+{
+	std::pair<ModbusServer*, int> *listener = (std::pair<ModbusServer*, int>*)arg;
+	ModbusServer *server = listener->first;
+	int fd = listener->second;
+	delete listener;
+
+	pthread_setname_np(pthread_self(), "mbserver");
+	server->accept_loop(fd);
+	return NULL;
+}
+
+void
+ModbusServer::start()
+{
+	int fd = tcp_listen(host, port);
+	pthread_t thread;
+	pthread_create(&thread, NULL, int_accept_loop, new std::pair<ModbusServer*, int>(this, fd));
+	pthread_detach(thread);
+}
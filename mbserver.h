@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_MBSERVER
+#define I_MBSERVER
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <map>
+#include "tcp.h"
+
+// Modbus/TCP slave serving the latest polled values through a virtual
+// register map, so other masters don't need to poll the field bus
+class ModbusServer : public Base {
+private:
+	enum {
+		TYPE_INT16,
+		TYPE_UINT16,
+		TYPE_INT32,
+		TYPE_UINT32,
+		TYPE_FLOAT32
+	};
+	struct Mapping {
+		uint8_t unit;
+		uint16_t reg;
+		String topic;
+		String field;
+		int type;
+		double scale;
+		bool valid;
+		double value;
+	};
+	struct Slot {
+		int64_t mapping;
+		int word;
+	};
+	Array<Mapping> mappings;
+	AArray<Array<int64_t>> by_topic;
+	std::map<uint32_t, Slot> registers;
+	Mutex mtx;
+	String host;
+	String port;
+	bool active;
+	TcpClients clients;
+
+	static void* int_accept_loop(void *arg);
+	static void* int_client_loop(void *arg);
+	void accept_loop(int fd);
+	void client_loop(int fd);
+	static int64_t clamp(double val, int64_t min, int64_t max, int64_t nan);
+	bool read_register(uint8_t unit, uint16_t reg, uint16_t& value, uint8_t& exception);
+
+public:
+	ModbusServer();
+	void setup(JSON& cfg);
+	bool enabled() const;
+	void start();
+	void update(const String& topic, JSON& data);
+	void invalidate(const String& topic);
+};
+
+#endif /* I_MBSERVER */
@@ -30,12 +30,20 @@
 
 #include "main.h"
 #include "mqtt.h"
+#include "trace.h"
 
 MQTT::MQTT()
 {
 	mosq = NULL;
 	rxbuf_enable = false;
 	autoonline = false;
+	protocol = 4;
+	topic_aliases = false;
+	message_expiry = 0;
+	spool = NULL;
+	alias_max = 0;
+	alias_next = 1;
+	connected = false;
 }
 
 MQTT::~MQTT()
@@ -50,7 +58,13 @@ MQTT::connect()
 	int rc;
 
 	if (mosq) {
-		mosquitto_connect_callback_set(mosq, int_connect_callback);
+		if (protocol == 5) {
+			mosquitto_int_option(mosq, MOSQ_OPT_PROTOCOL_VERSION, MQTT_PROTOCOL_V5);
+			mosquitto_connect_v5_callback_set(mosq, int_connect_v5_callback);
+		} else {
+			mosquitto_connect_callback_set(mosq, int_connect_callback);
+		}
+		mosquitto_disconnect_callback_set(mosq, int_disconnect_callback);
 		mosquitto_message_callback_set(mosq, int_message_callback);
 		String willtopic = maintopic + "/status";
 		if (!willtopic.empty()) {
@@ -86,25 +100,116 @@ MQTT::publish(const JSON& element, const String& message, bool retain, bool if_c
 	publish(topic, message, retain, if_changed, qos);
 }
 
-void
-MQTT::publish(const String& topic, const String& message, bool retain, bool if_changed, int qos)
+bool
+MQTT::publish(const String& topic, const String& message, bool retain, bool if_changed, int qos, const String& timestamp)
 {
 	bool send = true;
+	bool ret = true;
 	if (if_changed) {
-		rxdata_mtx.lock();
-		if (rxdata[topic] == message) {
-			send = false;
+		// compared with what we sent last, after a restart with
+		// the retained value the broker has sent us
+		bool known = false;
+		txdata_mtx.lock();
+		if (txdata.exists(topic)) {
+			known = true;
+			send = !(txdata[topic] == message);
 		}
-		rxdata_mtx.unlock();
-	}
-	if (send) {
-		mosquitto_publish(mosq, NULL, topic.c_str(), message.length(), message.c_str(), qos, retain);
-		if (!if_changed) {
+		txdata_mtx.unlock();
+		if (!known) {
 			rxdata_mtx.lock();
-			rxdata[topic] = message;
+			if (rxdata.exists(topic) && rxdata[topic] == message) {
+				send = false;
+			}
 			rxdata_mtx.unlock();
 		}
 	}
+	if (send) {
+		ret = publish_raw(topic, message.c_str(), message.length(), retain, qos, timestamp);
+		if (ret) {
+			txdata_mtx.lock();
+			txdata[topic] = message;
+			txdata_mtx.unlock();
+		}
+	}
+	return ret;
+}
+
+bool
+MQTT::publish_raw(const String& topic, const void *payload, size_t len, bool retain, int qos, const String& timestamp)
+{
+	TraceSpan span("mosquitto_publish");
+	if (protocol == 5) {
+		return publish_v5(topic, payload, len, retain, qos, timestamp);
+	}
+	int rc = mosquitto_publish(mosq, NULL, topic.c_str(), len, payload, qos, retain);
+	return (rc == MOSQ_ERR_SUCCESS);
+}
+
+void
+MQTT::publish_spooled(const String& topic, const void *payload, size_t len, int qos, const String& timestamp)
+{
+	if (spool != NULL && spool->enabled()) {
+		if (!is_connected() || !publish_raw(topic, payload, len, false, qos, timestamp)) {
+			spool->append(topic, payload, len, qos, false, timestamp);
+		}
+		return;
+	}
+	publish_raw(topic, payload, len, false, qos, timestamp);
+}
+
+bool
+MQTT::is_connected()
+{
+	conn_mtx.lock();
+	bool ret = connected;
+	conn_mtx.unlock();
+	return ret;
+}
+
+bool
+MQTT::publish_v5(const String& topic, const void *payload, size_t len, bool retain, int qos, const String& timestamp)
+{
+	mosquitto_property *props = NULL;
+	const char *pubtopic = topic.c_str();
+
+	if (!retain && message_expiry > 0) {
+		mosquitto_property_add_int32(&props, MQTT_PROP_MESSAGE_EXPIRY_INTERVAL, message_expiry);
+	}
+	if (!timestamp.empty()) {
+		mosquitto_property_add_string_pair(&props, MQTT_PROP_USER_PROPERTY, "timestamp", timestamp.c_str());
+	}
+
+	// the alias lock is held over the publish, so that the first message
+	// carrying the full topic is queued before any alias-only message;
+	// QoS 1 and 2 messages may be sent again on a new connection, where
+	// the alias is unknown, so they always carry the full topic
+	conn_mtx.lock();
+	if (topic_aliases && connected && qos == 0 && alias_topics.exists(topic)) {
+		if (topic_alias.exists(topic)) {
+			mosquitto_property_add_int16(&props, MQTT_PROP_TOPIC_ALIAS, topic_alias[topic]);
+			pubtopic = "";
+		} else if (alias_next <= alias_max) {
+			topic_alias[topic] = alias_next;
+			mosquitto_property_add_int16(&props, MQTT_PROP_TOPIC_ALIAS, alias_next);
+			alias_next++;
+		}
+	}
+	int rc = mosquitto_publish_v5(mosq, NULL, pubtopic, len, payload, qos, retain, props);
+	conn_mtx.unlock();
+
+	mosquitto_property_free_all(&props);
+	return (rc == MOSQ_ERR_SUCCESS);
+}
+
+void
+MQTT::add_alias(const String& topic)
+{
+	// topics, which get an alias as long as the broker has some left
+	conn_mtx.lock();
+	if (!alias_topics.exists(topic)) {
+		alias_topics[topic] = true;
+	}
+	conn_mtx.unlock();
 }
 
 void
@@ -123,9 +228,46 @@ MQTT::int_connect_callback(struct mosquitto *mosq, void *obj, int result)
 	me->connect_callback(result);
 }
 
+void
+MQTT::int_connect_v5_callback(struct mosquitto *mosq, void *obj, int result, int flags, const mosquitto_property *props)
+{
+	MQTT* me = (MQTT*)obj;
+	uint16_t max = 0;
+
+	// aliases are only valid for a single network connection
+	me->conn_mtx.lock();
+	if (result == 0) {
+		mosquitto_property_read_int16(props, MQTT_PROP_TOPIC_ALIAS_MAXIMUM, &max, false);
+	}
+	AArray<uint16_t> empty;
+	std::swap(me->topic_alias, empty);
+	me->alias_max = max;
+	me->alias_next = 1;
+	me->conn_mtx.unlock();
+	me->connect_callback(result);
+}
+
+void
+MQTT::int_disconnect_callback(struct mosquitto *mosq, void *obj, int result)
+{
+	MQTT* me = (MQTT*)obj;
+	me->disconnect_callback(result);
+}
+
+void
+MQTT::disconnect_callback(int result)
+{
+	conn_mtx.lock();
+	connected = false;
+	conn_mtx.unlock();
+}
+
 void
 MQTT::connect_callback(int result)
 {
+	conn_mtx.lock();
+	connected = (result == 0);
+	conn_mtx.unlock();
 	if (result == 0) {
 		subscribtion_mtx.lock();
 		for (int64_t i = 0; i <= subscribtions.max; i++) {
@@ -144,21 +286,27 @@ MQTT::int_message_callback(struct mosquitto *mosq, void *obj, const struct mosqu
 {
 	MQTT* me = (MQTT*)obj;
 
-	String topic = message->topic;
-	String msg = (char*)message->payload;
-	me->message_callback(topic, msg);
+	// the payload is not guaranteed to be NUL terminated and may
+	// contain NUL bytes, so it is taken by length
+	RXbuf rx;
+	rx.topic = message->topic;
+	rx.message = String((const char*)message->payload, (size_t)message->payloadlen);
+	me->message_callback(rx);
 }
 
 void
-MQTT::message_callback(const String& topic, const String& message)
+MQTT::message_callback(RXbuf& rx)
 {
-	rxdata_mtx.lock();
-	rxdata[topic] = message;
+	// commands go straight to the device queue, everything else
+	// is kept as last received value
 	if (rxbuf_enable) {
-		int64_t newpos = rxbuf.max + 1;
-		rxbuf[newpos].topic = topic;
-		rxbuf[newpos].message = message;
+		if (!rxring.push(rx)) {
+			syslog(LOG_WARNING, "%s: command queue full, dropping message", maintopic.c_str());
+		}
+		return;
 	}
+	rxdata_mtx.lock();
+	std::swap(rxdata[rx.topic], rx.message);
 	rxdata_mtx.unlock();
 }
 
@@ -166,12 +314,19 @@ Array<MQTT::RXbuf>
 MQTT::get_rxbuf()
 {
 	Array<RXbuf> tmp;
-	rxdata_mtx.lock();
-	std::swap(tmp, rxbuf);
-	rxdata_mtx.unlock();
+	RXbuf rx;
+	while (rxring.pop(rx)) {
+		std::swap(tmp[tmp.max + 1], rx);
+	}
 	return tmp;
 }
 
+bool
+MQTT::rx_pending() const
+{
+	return !rxring.empty();
+}
+
 void
 MQTT::check_online(const JSON& element)
 {
@@ -214,3 +369,17 @@ MQTT::operator[](const String& topic)
 	return ret;
 }
 
+bool
+MQTT::sent(const String& topic, String& message)
+{
+	// last message handed to the broker on topic, received values
+	// are only returned by operator[]
+	bool ret = false;
+	txdata_mtx.lock();
+	if (txdata.exists(topic)) {
+		message = txdata[topic];
+		ret = true;
+	}
+	txdata_mtx.unlock();
+	return ret;
+}
@@ -34,6 +34,8 @@
 #include "main.h"
 #include <bwctmb/bwctmb.h>
 #include <mosquitto.h>
+#include "spool.h"
+#include "spsc.h"
 
 class MQTT : public Base {
 public:
@@ -130,14 +132,25 @@ private:
 	struct mosquitto *mosq;
 	AArray<String> rxdata;
 	Mutex rxdata_mtx;
-	Array<RXbuf> rxbuf;
+	AArray<String> txdata;
+	Mutex txdata_mtx;
+	SPSCRing<RXbuf, 64> rxring;
 	Array<String> subscribtions;
 	Mutex subscribtion_mtx;
+	AArray<uint16_t> topic_alias;
+	AArray<bool> alias_topics;
+	uint16_t alias_max;
+	uint16_t alias_next;
+	bool connected;
+	Mutex conn_mtx;
 
 	static void int_connect_callback(struct mosquitto *mosq, void *obj, int result);
+	static void int_connect_v5_callback(struct mosquitto *mosq, void *obj, int result, int flags, const mosquitto_property *props);
+	static void int_disconnect_callback(struct mosquitto *mosq, void *obj, int result);
 	void connect_callback(int result);
+	void disconnect_callback(int result);
+	bool publish_v5(const String& topic, const void *payload, size_t len, bool retain, int qos, const String& timestamp);
 	static void int_message_callback(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message);
-	void message_callback(const String& topic, const String& message);
 
 public:
 	String id;
@@ -150,17 +163,28 @@ public:
 	String product;
 	String version;
 	bool autoonline;
+	int protocol;
+	bool topic_aliases;
+	uint32_t message_expiry;
+	Spool *spool;
 
 	MQTT();
 	~MQTT();
 	bool connect(void);
 	void disconnect(void);
 	void publish(const JSON& element, const String& message, bool retain = true, bool if_changed = false, int qos = 1);
-	void publish(const String& topic, const String& message, bool retain = true, bool if_changed = false, int qos = 1);
+	bool publish(const String& topic, const String& message, bool retain = true, bool if_changed = false, int qos = 1, const String& timestamp = String());
+	bool publish_raw(const String& topic, const void *payload, size_t len, bool retain, int qos, const String& timestamp = String());
+	void publish_spooled(const String& topic, const void *payload, size_t len, int qos, const String& timestamp);
+	bool is_connected();
 	void subscribe(const String& topic);
+	void add_alias(const String& topic);
 	Array<RXbuf> get_rxbuf();
+	bool rx_pending() const;
 	Datawrapper operator[](const String& topic);
 	Datawrapper operator[](const JSON& element);
+	bool sent(const String& topic, String& message);
+	void message_callback(RXbuf& rx);
 	void check_online(const JSON& element);
 };
 
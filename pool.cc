@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "pool.h"
+#include "trace.h"
+
+WorkerPool::WorkerPool()
+{
+	queues = NULL;
+	nworkers = 0;
+	queuesize = 0;
+	fn = NULL;
+}
+
+void
+WorkerPool::start(int64_t threads, int64_t size, jobfn handler)
+{
+	fn = handler;
+	if (threads < 1) {
+		return;
+	}
+	if (size < 1) {
+		size = 1;
+	}
+	queuesize = size;
+	queues = new Queue[threads];
+	for (int64_t i = 0; i < threads; i++) {
+		Queue& q = queues[i];
+		pthread_mutex_init(&q.mtx, NULL);
+		pthread_cond_init(&q.notempty, NULL);
+		pthread_cond_init(&q.notfull, NULL);
+		q.jobs = new Job[queuesize];
+		q.head = 0;
+		q.count = 0;
+	}
+	nworkers = threads;
+	for (int64_t i = 0; i < threads; i++) {
+		Worker *worker = new Worker;
+		worker->pool = this;
+		worker->no = i;
+		pthread_t thread;
+		pthread_create(&thread, NULL, int_loop, worker);
+		pthread_detach(thread);
+	}
+}
+
+void
+WorkerPool::submit(uint64_t key, Job& job)
+{
+	if (nworkers == 0) {
+		(*fn)(job);
+		return;
+	}
+
+	// jobs of one device always go to the same worker to keep their order
+	Queue& q = queues[key % nworkers];
+	pthread_mutex_lock(&q.mtx);
+	while (q.count == queuesize) {
+		// backpressure: the bus thread waits for the worker
+		pthread_cond_wait(&q.notfull, &q.mtx);
+	}
+	Job& slot = q.jobs[(q.head + q.count) % queuesize];
+	std::swap(slot, job);
+	q.count++;
+	pthread_cond_signal(&q.notempty);
+	pthread_mutex_unlock(&q.mtx);
+}
+
+void*
+WorkerPool::int_loop(void *arg)
+{
+	Worker *worker = (Worker*)arg;
+	WorkerPool *pool = worker->pool;
+	int64_t no = worker->no;
+	delete worker;
+
+	String threadname = S + "worker" + no;
+	pthread_setname_np(pthread_self(), threadname.c_str());
+	trace_thread(threadname);
+	pool->loop(no);
+	return NULL;
+}
+
+void
+WorkerPool::loop(int64_t no)
+{
+	Queue& q = queues[no];
+
+	for (;;) {
+		Job job;
+		pthread_mutex_lock(&q.mtx);
+		while (q.count == 0) {
+			pthread_cond_wait(&q.notempty, &q.mtx);
+		}
+		std::swap(job, q.jobs[q.head]);
+		q.head = (q.head + 1) % queuesize;
+		q.count--;
+		pthread_cond_signal(&q.notfull);
+		pthread_mutex_unlock(&q.mtx);
+
+		try {
+			(*fn)(job);
+		} catch (...) {
+		}
+	}
+}
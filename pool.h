@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_POOL
+#define I_POOL
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include "device.h"
+
+class WorkerPool : public Base {
+public:
+	struct Job {
+		Device *dev;
+		String timestamp;
+		String status;
+		bool has_data;
+		JSON data;
+	};
+	typedef void (*jobfn)(Job& job);
+private:
+	struct Queue {
+		pthread_mutex_t mtx;
+		pthread_cond_t notempty;
+		pthread_cond_t notfull;
+		Job *jobs;
+		int64_t head;
+		int64_t count;
+	};
+	struct Worker {
+		WorkerPool *pool;
+		int64_t no;
+	};
+	Queue *queues;
+	int64_t nworkers;
+	int64_t queuesize;
+	jobfn fn;
+
+	static void* int_loop(void *arg);
+	void loop(int64_t no);
+
+public:
+	WorkerPool();
+	void start(int64_t threads, int64_t size, jobfn handler);
+	void submit(uint64_t key, Job& job);
+};
+
+#endif /* I_POOL */
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "proxy.h"
+#include "tcp.h"
+#include <sys/socket.h>
+
+#define MB_ILLEGAL_FUNCTION 0x01
+#define MB_ILLEGAL_ADDRESS 0x02
+#define MB_ILLEGAL_VALUE 0x03
+#define MB_DEVICE_FAILURE 0x04
+#define MB_PATH_UNAVAILABLE 0x0a
+#define MB_TARGET_FAILED 0x0b
+
+ModbusProxy::ModbusProxy()
+{
+	pthread_mutex_init(&mtx, NULL);
+	pthread_cond_init(&done_cond, NULL);
+	pthread_cond_init(&work_cond, NULL);
+	ttl = 1.0;
+	active = false;
+}
+
+void
+ModbusProxy::setup(JSON& cfg, const String& name)
+{
+	this->name = name;
+	if (cfg.exists("listen")) {
+		String tmp = cfg["listen"];
+		host = tmp;
+	}
+	port = cfg["port"].get_numstr();
+	clients.setup(cfg);
+	if (cfg.exists("ttl")) {
+		String tmp = cfg["ttl"].get_numstr();
+		ttl = tmp.getd();
+	}
+	active = true;
+}
+
+bool
+ModbusProxy::enabled() const
+{
+	return active;
+}
+
+double
+ModbusProxy::now()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (double)tp.tv_sec + (double)tp.tv_nsec / 1000000000;
+}
+
+bool
+ModbusProxy::is_read(uint8_t function)
+{
+	return (function >= 0x01 && function <= 0x04);
+}
+
+uint64_t
+ModbusProxy::key(const Request& req)
+{
+	return ((uint64_t)req.unit << 40) | ((uint64_t)req.function << 32) | ((uint64_t)req.reg << 16) | req.count;
+}
+
+void
+ModbusProxy::execute(Bus& mb, Request& req)
+{
+	// called by the bus thread without mtx
+	try {
+		mb.direct(req.unit, req.function, req.reg, req.count, req.registers, req.bits);
+		req.exception = 0;
+	} catch (ModbusError& e) {
+		if (e.code != 0) {
+			// exception of the device or of a gateway on the way
+			req.exception = e.code;
+		} else if (e.kind == ModbusError::TIMEOUT) {
+			req.exception = MB_TARGET_FAILED;
+		} else if (e.kind == ModbusError::CONNECTION) {
+			req.exception = MB_PATH_UNAVAILABLE;
+		} else {
+			req.exception = MB_DEVICE_FAILURE;
+		}
+	} catch (...) {
+		req.exception = MB_DEVICE_FAILURE;
+	}
+}
+
+void
+ModbusProxy::process(Bus& mb, int max)
+{
+	for (int n = 0; n < max; n++) {
+		pthread_mutex_lock(&mtx);
+		if (queue.empty()) {
+			pthread_mutex_unlock(&mtx);
+			return;
+		}
+		Request *req = queue.front();
+		queue.pop_front();
+		pthread_mutex_unlock(&mtx);
+
+		uint64_t k = key(*req);
+		double t = now();
+		if (is_read(req->function)) {
+			// writes of the bridge itself outdate the entries as well
+			uint64_t writes = mb.write_count(req->unit);
+			auto it = cache.find(k);
+			if (it != cache.end() && t - it->second.time < ttl && it->second.writes == writes) {
+				req->registers = it->second.registers;
+				req->bits = it->second.bits;
+				req->exception = 0;
+			} else {
+				execute(mb, *req);
+				if (req->exception == 0) {
+					CacheEntry& entry = cache[k];
+					entry.registers = req->registers;
+					entry.bits = req->bits;
+					entry.time = t;
+					entry.writes = writes;
+				}
+			}
+		} else {
+			execute(mb, *req);
+			// anything of this unit may have changed
+			for (auto it = cache.begin(); it != cache.end();) {
+				if ((it->first >> 40) == req->unit) {
+					it = cache.erase(it);
+				} else {
+					++it;
+				}
+			}
+		}
+
+		pthread_mutex_lock(&mtx);
+		req->done = true;
+		if (is_read(req->function)) {
+			// answer identical reads, which came in meanwhile, with the same result
+			for (auto it = queue.begin(); it != queue.end();) {
+				Request *other = *it;
+				if (key(*other) == k) {
+					other->registers = req->registers;
+					other->bits = req->bits;
+					other->exception = req->exception;
+					other->done = true;
+					it = queue.erase(it);
+				} else {
+					++it;
+				}
+			}
+		}
+		pthread_cond_broadcast(&done_cond);
+		pthread_mutex_unlock(&mtx);
+	}
+}
+
+bool
+ModbusProxy::wait(double seconds)
+{
+	// sleep of the bus thread, which ends early for proxy requests
+	bool woken = false;
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	int64_t ns = ts.tv_nsec + (int64_t)(seconds * 1000000000);
+	ts.tv_sec += ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+	pthread_mutex_lock(&mtx);
+	if (queue.empty()) {
+		pthread_cond_timedwait(&work_cond, &mtx, &ts);
+	}
+	woken = !queue.empty();
+	pthread_mutex_unlock(&mtx);
+	return woken;
+}
+
+void
+ModbusProxy::client_loop(int fd)
+{
+	uint8_t req[260];
+	uint8_t resp[260];
+	for (;;) {
+		// MBAP header: transaction, protocol, length, unit
+		if (!tcp_read(fd, req, 7)) {
+			break;
+		}
+		uint16_t len = (req[4] << 8) | req[5];
+		if (req[2] != 0 || req[3] != 0 || len < 2 || len > 254) {
+			break;
+		}
+		if (!tcp_read(fd, req + 7, len - 1)) {
+			break;
+		}
+		memcpy(resp, req, 7);
+		Request r;
+		r.unit = req[6];
+		r.function = req[7];
+		r.exception = 0;
+		r.done = false;
+		if (r.function < 0x01 || r.function > 0x06 || len != 6) {
+			r.exception = MB_ILLEGAL_FUNCTION;
+		} else {
+			r.reg = (req[8] << 8) | req[9];
+			r.count = (req[10] << 8) | req[11];
+			if ((r.function <= 0x02 && (r.count < 1 || r.count > 2000)) ||
+			    ((r.function == 0x03 || r.function == 0x04) && (r.count < 1 || r.count > 125))) {
+				r.exception = MB_ILLEGAL_VALUE;
+			} else if (r.function == 0x05 && r.count != 0xff00 && r.count != 0x0000) {
+				r.exception = MB_ILLEGAL_VALUE;
+			} else if (r.function <= 0x04 && (uint32_t)r.reg + r.count > 0x10000) {
+				r.exception = MB_ILLEGAL_ADDRESS;
+			}
+		}
+		if (r.exception == 0) {
+			pthread_mutex_lock(&mtx);
+			queue.push_back(&r);
+			pthread_cond_signal(&work_cond);
+			while (!r.done) {
+				pthread_cond_wait(&done_cond, &mtx);
+			}
+			pthread_mutex_unlock(&mtx);
+		}
+
+		size_t resplen;
+		resp[7] = r.function;
+		if (r.exception != 0) {
+			resp[7] = r.function | 0x80;
+			resp[8] = r.exception;
+			resplen = 2;
+		} else if (r.function <= 0x02) {
+			uint8_t bytes = (r.count + 7) / 8;
+			resp[8] = bytes;
+			memset(resp + 9, 0, bytes);
+			for (int i = 0; i < r.count; i++) {
+				if (r.bits[i]) {
+					resp[9 + i / 8] |= 1 << (i % 8);
+				}
+			}
+			resplen = 2 + bytes;
+		} else if (r.function <= 0x04) {
+			resp[8] = r.count * 2;
+			for (int i = 0; i < r.count; i++) {
+				resp[9 + i * 2] = r.registers[i] >> 8;
+				resp[10 + i * 2] = r.registers[i] & 0xff;
+			}
+			resplen = 2 + r.count * 2;
+		} else {
+			// writes echo the request
+			memcpy(resp + 8, req + 8, 4);
+			resplen = 5;
+		}
+		resp[4] = (resplen + 1) >> 8;
+		resp[5] = (resplen + 1) & 0xff;
+		if (!tcp_write(fd, resp, 7 + resplen)) {
+			break;
+		}
+	}
+	close(fd);
+	clients.remove();
+}
+
+void*
+ModbusProxy::int_client_loop(void *arg)
+{
+	std::pair<ModbusProxy*, int> *client = (std::pair<ModbusProxy*, int>*)arg;
+	ModbusProxy *proxy = client->first;
+	int fd = client->second;
+	delete client;
+
+	pthread_setname_np(pthread_self(), "proxy client");
+	proxy->client_loop(fd);
+	return NULL;
+}
+
+void
+ModbusProxy::accept_loop(int fd)
+{
+	for (;;) {
+		int cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			if (errno != EINTR) {
+				syslog(LOG_ERR, "%s: proxy accept failed: %s", name.c_str(), strerror(errno));
+				sleep(1);
+			}
+			continue;
+		}
+		if (!clients.add(cfd)) {
+			syslog(LOG_WARNING, "%s: too many proxy clients, closing connection", name.c_str());
+			close(cfd);
+			continue;
+		}
+		pthread_t thread;
+		auto client = new std::pair<ModbusProxy*, int>(this, cfd);
+		if (pthread_create(&thread, NULL, int_client_loop, client) != 0) {
+			delete client;
+			close(cfd);
+			clients.remove();
+			continue;
+		}
+		pthread_detach(thread);
+	}
+}
+
+void*
+ModbusProxy::int_accept_loop(void *arg)
+{
+	std::pair<ModbusProxy*, int> *listener = (std::pair<ModbusProxy*, int>*)arg;
+	ModbusProxy *proxy = listener->first;
+	int fd = listener->second;
+	delete listener;
+
+	pthread_setname_np(pthread_self(), "proxy");
+	proxy->accept_loop(fd);
+	return NULL;
+}
+
+void
+ModbusProxy::start()
+{
+	int fd = tcp_listen(host, port);
+	pthread_t thread;
+	pthread_create(&thread, NULL, int_accept_loop, new std::pair<ModbusProxy*, int>(this, fd));
+	pthread_detach(thread);
+}
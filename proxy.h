@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_PROXY
+#define I_PROXY
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <map>
+#include <deque>
+#include "bus.h"
+#include "tcp.h"
+
+// Modbus/TCP listener of one bus, the requests are executed by the bus
+// thread between the device polls, identical reads are merged and
+// answered from a short lived cache
+class ModbusProxy : public Base {
+private:
+	struct Request {
+		uint8_t unit;
+		uint8_t function;
+		uint16_t reg;
+		uint16_t count;
+		Array<uint16_t> registers;
+		Array<bool> bits;
+		uint8_t exception;
+		bool done;
+	};
+	struct CacheEntry {
+		Array<uint16_t> registers;
+		Array<bool> bits;
+		double time;
+		uint64_t writes;
+	};
+	pthread_mutex_t mtx;
+	pthread_cond_t done_cond;
+	pthread_cond_t work_cond;
+	std::deque<Request*> queue;
+	std::map<uint64_t, CacheEntry> cache;
+	String host;
+	String port;
+	String name;
+	double ttl;
+	bool active;
+	TcpClients clients;
+
+	static uint64_t key(const Request& req);
+	static bool is_read(uint8_t function);
+	static double now();
+	static void* int_accept_loop(void *arg);
+	static void* int_client_loop(void *arg);
+	void accept_loop(int fd);
+	void client_loop(int fd);
+	void execute(Bus& mb, Request& req);
+
+public:
+	ModbusProxy();
+	void setup(JSON& cfg, const String& name);
+	bool enabled() const;
+	void start();
+	void process(Bus& mb, int max);
+	bool wait(double seconds);
+};
+
+#endif /* I_PROXY */
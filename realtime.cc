@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "realtime.h"
+#include <sched.h>
+#include <sys/mman.h>
+#ifdef __FreeBSD__
+#include <pthread_np.h>
+#include <sys/cpuset.h>
+#endif
+
+void
+realtime_setup(JSON& rt_cfg, const String& name)
+{
+	if (rt_cfg.exists("mlock")) {
+		bool mlock = rt_cfg["mlock"];
+		// process wide, but doing it twice doesn't hurt
+		if (mlock && mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+			syslog(LOG_ERR, "%s: mlockall failed: %s", name.c_str(), strerror(errno));
+		}
+	}
+	if (rt_cfg.exists("cpu")) {
+		int64_t cpu = rt_cfg["cpu"].get_numstr().getll();
+		// CPU_SET doesn't check the range
+		if (cpu < 0 || cpu >= CPU_SETSIZE) {
+			syslog(LOG_ERR, "%s: invalid cpu %lld", name.c_str(), (long long)cpu);
+		} else {
+#ifdef __FreeBSD__
+			cpuset_t set;
+#else
+			cpu_set_t set;
+#endif
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			if (rc != 0) {
+				syslog(LOG_ERR, "%s: failed to bind to cpu %lld: %s", name.c_str(), (long long)cpu, strerror(rc));
+			}
+		}
+	}
+	if (rt_cfg.exists("priority")) {
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = rt_cfg["priority"].get_numstr().getll();
+		int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (rc != 0) {
+			syslog(LOG_ERR, "%s: failed to set SCHED_FIFO priority %d: %s", name.c_str(), param.sched_priority, strerror(rc));
+		}
+	}
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "sched.h"
+
+#define SCHED_REPORT_INTERVAL 10
+
+static const char *class_names[] = {"command", "fast", "telemetry", "bulk"};
+
+BusScheduler::BusScheduler()
+{
+	vtime = 0;
+	for (int i = 0; i < PRIO_CLASSES; i++) {
+		busy[i] = 0;
+		polls[i] = 0;
+	}
+	report_time = -1;
+	report_busy = 0;
+	memset(latency_hist, 0, sizeof(latency_hist));
+	have_latency = false;
+}
+
+double
+BusScheduler::weight(int prio)
+{
+	switch (prio) {
+	case PRIO_COMMAND:
+		return 8;
+	case PRIO_FAST:
+		return 4;
+	case PRIO_TELEMETRY:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+int
+BusScheduler::parse_class(const String& name)
+{
+	for (int i = 0; i < PRIO_CLASSES; i++) {
+		if (name == class_names[i]) {
+			return i;
+		}
+	}
+	throw Error(S + "unknown priority class " + name);
+}
+
+const char*
+BusScheduler::class_name(int prio)
+{
+	return class_names[prio];
+}
+
+int64_t
+BusScheduler::select(const Array<int>& due)
+{
+	// due holds the class of each device ready to poll or -1,
+	// commands always go first, then the smallest start tag
+	int64_t ret = -1;
+	int best_prio = PRIO_CLASSES;
+	double best_start = 0;
+	for (int64_t i = 0; i <= due.max; i++) {
+		int prio = due[i];
+		if (prio < 0) {
+			continue;
+		}
+		double start = (i <= finish.max && finish[i] > vtime) ? finish[i] : vtime;
+		bool command = (prio == PRIO_COMMAND);
+		bool best_command = (best_prio == PRIO_COMMAND);
+		if (ret < 0 || (command && !best_command) || (command == best_command && start < best_start)) {
+			ret = i;
+			best_prio = prio;
+			best_start = start;
+		}
+	}
+	return ret;
+}
+
+void
+BusScheduler::account(int64_t idx, int prio, double cost)
+{
+	double start = (idx <= finish.max && finish[idx] > vtime) ? finish[idx] : vtime;
+	finish[idx] = start + cost / weight(prio);
+	vtime = start;
+	busy[prio] += cost;
+	polls[prio]++;
+}
+
+void
+BusScheduler::wakeup_latency(double latency)
+{
+	// log2 microsecond buckets of how late the thread woke up
+	uint64_t us = (latency > 0) ? latency * 1000000 : 0;
+	int bucket = 0;
+	while (bucket < 31 && us >= ((uint64_t)2 << bucket)) {
+		bucket++;
+	}
+	latency_hist[bucket]++;
+	have_latency = true;
+}
+
+bool
+BusScheduler::report(double now, double bus_busy, JSON& out)
+{
+	if (report_time < 0) {
+		report_time = now;
+		report_busy = bus_busy;
+		return false;
+	}
+	double elapsed = now - report_time;
+	if (elapsed < SCHED_REPORT_INTERVAL) {
+		return false;
+	}
+	AArray<JSON> data;
+	data["utilization"].set_number(d_to_s((bus_busy - report_busy) / elapsed, 3));
+	AArray<JSON> classes;
+	for (int i = 0; i < PRIO_CLASSES; i++) {
+		AArray<JSON> cls;
+		cls["utilization"].set_number(d_to_s(busy[i] / elapsed, 3));
+		cls["polls"].set_number(S + polls[i]);
+		classes[class_names[i]] = cls;
+		busy[i] = 0;
+		polls[i] = 0;
+	}
+	data["classes"] = classes;
+	if (have_latency) {
+		// keyed by the upper bound of the bucket in microseconds
+		AArray<JSON> latency;
+		for (int i = 0; i < 32; i++) {
+			if (latency_hist[i] > 0) {
+				latency[S + ((uint64_t)2 << i)].set_number(S + latency_hist[i]);
+			}
+		}
+		data["wakeup_latency_us"] = latency;
+		memset(latency_hist, 0, sizeof(latency_hist));
+	}
+	out = data;
+	report_time = now;
+	report_busy = bus_busy;
+	return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_SCHED
+#define I_SCHED
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+
+// Start-time fair queuing of the device polls on one bus, weighted by
+// priority class and charged with the bus time a poll really took.
+class BusScheduler : public Base {
+public:
+	enum {
+		PRIO_COMMAND,
+		PRIO_FAST,
+		PRIO_TELEMETRY,
+		PRIO_BULK,
+		PRIO_CLASSES
+	};
+private:
+	Array<double> finish;
+	double vtime;
+	double busy[PRIO_CLASSES];
+	int64_t polls[PRIO_CLASSES];
+	double report_time;
+	double report_busy;
+	uint64_t latency_hist[32];
+	bool have_latency;
+
+	static double weight(int prio);
+
+public:
+	static int parse_class(const String& name);
+	static const char* class_name(int prio);
+
+	BusScheduler();
+	int64_t select(const Array<int>& due);
+	void account(int64_t idx, int prio, double cost);
+	void wakeup_latency(double latency);
+	bool report(double now, double bus_busy, JSON& out);
+};
+
+#endif /* I_SCHED */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "snapshot.h"
+#include "clock.h"
+
+BusSnapshot::BusSnapshot()
+{
+	active = false;
+	suppress = false;
+	qos = 0;
+	max_interval = 60;
+	last = -1;
+	ndevices = 0;
+	npolled = 0;
+}
+
+void
+BusSnapshot::setup(JSON& snap_cfg, const String& default_topic, int64_t devices)
+{
+	topic = default_topic;
+	if (snap_cfg.exists("topic")) {
+		String tmp = snap_cfg["topic"];
+		topic = tmp;
+	}
+	if (snap_cfg.exists("suppress_devices")) {
+		suppress = snap_cfg["suppress_devices"];
+	}
+	if (snap_cfg.exists("qos")) {
+		qos = snap_cfg["qos"].get_numstr().getll();
+	}
+	if (snap_cfg.exists("max_interval")) {
+		String tmp = snap_cfg["max_interval"].get_numstr();
+		max_interval = tmp.getd();
+	}
+	ndevices = devices;
+	for (int64_t i = 0; i < ndevices; i++) {
+		polled[i] = false;
+	}
+	active = true;
+}
+
+bool
+BusSnapshot::enabled() const
+{
+	return active;
+}
+
+bool
+BusSnapshot::suppress_devices() const
+{
+	return (active && suppress);
+}
+
+void
+BusSnapshot::update(int64_t idx, const String& key, const String& status, const JSON *data)
+{
+	// a failed device keeps its last data next to the new status
+	if (!sections.exists(key)) {
+		AArray<JSON> tmp;
+		sections[key] = tmp;
+	}
+	sections[key]["status"] = status;
+	if (data != NULL) {
+		sections[key]["data"] = *data;
+	}
+	if (!polled[idx]) {
+		polled[idx] = true;
+		npolled++;
+	}
+}
+
+void
+BusSnapshot::flush(double now, MQTT& mqtt)
+{
+	if (last < 0) {
+		last = now;
+	}
+	// slow devices don't hold back the others forever
+	if (npolled == 0 || (npolled < ndevices && now - last < max_interval)) {
+		return;
+	}
+	struct timespec tp;
+	clock_gettime(CLOCK_REALTIME_FAST, &tp);
+	JSON doc;
+	{
+		AArray<JSON> tmp;
+		tmp["time"] = clock_string(tp.tv_sec);
+		tmp["devices"] = sections;
+		doc = tmp;
+	}
+	// with suppress_devices this is the only copy of the data, so it
+	// takes the spool like the device data does
+	String payload = doc.generate();
+	mqtt.publish_spooled(topic, payload.c_str(), payload.length(), qos, String());
+	for (int64_t i = 0; i < ndevices; i++) {
+		polled[i] = false;
+	}
+	npolled = 0;
+	last = now;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_SNAPSHOT
+#define I_SNAPSHOT
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include "mqtt.h"
+
+// all devices of a bus in one message, published once every device was
+// polled since the last one; flush is called by the bus thread between
+// polls, so the message is late by at most the poll running at the time
+class BusSnapshot : public Base {
+private:
+	String topic;
+	bool active;
+	bool suppress;
+	int qos;
+	double max_interval;
+	double last;
+	int64_t ndevices;
+	int64_t npolled;
+	Array<bool> polled;
+	AArray<JSON> sections;
+
+public:
+	BusSnapshot();
+	void setup(JSON& snap_cfg, const String& default_topic, int64_t devices);
+	bool enabled() const;
+	bool suppress_devices() const;
+	void update(int64_t idx, const String& key, const String& status, const JSON *data);
+	void flush(double now, MQTT& mqtt);
+};
+
+#endif /* I_SNAPSHOT */
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "spool.h"
+#include <sys/mman.h>
+
+#define SPOOL_MAGIC 0x6d627370
+#define SPOOL_VERSION 1
+
+static inline uint64_t
+spool_align(uint64_t len)
+{
+	return (len + 7) & ~(uint64_t)7;
+}
+
+Spool::Spool()
+{
+	fd = -1;
+	mapsize = 0;
+	map = NULL;
+	hdr = NULL;
+	data = NULL;
+}
+
+Spool::~Spool()
+{
+	if (map != NULL) {
+		msync(map, mapsize, MS_SYNC);
+		munmap(map, mapsize);
+	}
+	if (fd >= 0) {
+		::close(fd);
+	}
+}
+
+void
+Spool::open(const String& path, uint64_t size)
+{
+	size = spool_align(size);
+	if (size < 4096) {
+		throw Error(S + "spool size " + size + " too small");
+	}
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		throw Error(S + "failed to open spool " + path + ": " + strerror(errno));
+	}
+	mapsize = sizeof(Header) + size;
+	if (ftruncate(fd, mapsize) < 0) {
+		throw Error(S + "failed to size spool " + path + ": " + strerror(errno));
+	}
+	void *addr = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		throw Error(S + "failed to map spool " + path + ": " + strerror(errno));
+	}
+	map = (uint8_t*)addr;
+	hdr = (Header*)map;
+	data = map + sizeof(Header);
+
+	// keep the content of an existing spool across restarts
+	if (hdr->magic != SPOOL_MAGIC || hdr->version != SPOOL_VERSION || hdr->size != size ||
+	    hdr->head >= size || hdr->tail >= size || hdr->used > size) {
+		hdr->magic = SPOOL_MAGIC;
+		hdr->version = SPOOL_VERSION;
+		hdr->size = size;
+		hdr->head = 0;
+		hdr->tail = 0;
+		hdr->used = 0;
+		hdr->dropped = 0;
+	}
+}
+
+bool
+Spool::enabled()
+{
+	return (map != NULL);
+}
+
+bool
+Spool::empty()
+{
+	if (map == NULL) {
+		return true;
+	}
+	mtx.lock();
+	bool ret = (hdr->used == 0);
+	mtx.unlock();
+	return ret;
+}
+
+void
+Spool::drop_oldest()
+{
+	uint64_t tail = hdr->tail;
+	Record *rec = (Record*)(data + tail);
+
+	if (hdr->size - tail < sizeof(Record) || rec->reclen == 0) {
+		// wrap marker, the rest of the ring is unused
+		hdr->used -= hdr->size - tail;
+		hdr->tail = 0;
+	} else {
+		hdr->used -= rec->reclen;
+		tail += rec->reclen;
+		hdr->tail = (tail == hdr->size) ? 0 : tail;
+	}
+	if (hdr->used == 0) {
+		hdr->head = 0;
+		hdr->tail = 0;
+	}
+}
+
+void
+Spool::append(const String& topic, const void *payload, size_t len, int qos, bool retain, const String& timestamp)
+{
+	if (map == NULL) {
+		return;
+	}
+	uint64_t need = spool_align(sizeof(Record) + topic.length() + timestamp.length() + len);
+	if (need > hdr->size / 2 || topic.length() > UINT16_MAX || timestamp.length() > UINT8_MAX) {
+		return;
+	}
+
+	mtx.lock();
+	if (hdr->head + need > hdr->size) {
+		uint64_t waste = hdr->size - hdr->head;
+		while (hdr->used > 0 && hdr->tail >= hdr->head) {
+			drop_oldest();
+			hdr->dropped++;
+		}
+		if (hdr->used > 0) {
+			if (waste >= sizeof(Record)) {
+				((Record*)(data + hdr->head))->reclen = 0;
+			}
+			hdr->used += waste;
+		}
+		hdr->head = 0;
+	}
+	while (hdr->size - hdr->used < need) {
+		drop_oldest();
+		hdr->dropped++;
+	}
+
+	uint8_t *pos = data + hdr->head;
+	Record *rec = (Record*)pos;
+	rec->msglen = len;
+	rec->topiclen = topic.length();
+	rec->tslen = timestamp.length();
+	rec->flags = (qos & 0x3) | (retain ? 0x4 : 0);
+	pos += sizeof(Record);
+	memcpy(pos, topic.c_str(), topic.length());
+	pos += topic.length();
+	memcpy(pos, timestamp.c_str(), timestamp.length());
+	pos += timestamp.length();
+	memcpy(pos, payload, len);
+	// the length is written last, so a torn record is never read back
+	rec->reclen = need;
+
+	hdr->head += need;
+	if (hdr->head == hdr->size) {
+		hdr->head = 0;
+	}
+	hdr->used += need;
+	mtx.unlock();
+}
+
+bool
+Spool::peek(Entry& entry)
+{
+	if (map == NULL) {
+		return false;
+	}
+	mtx.lock();
+	while (hdr->used > 0) {
+		uint64_t tail = hdr->tail;
+		Record *rec = (Record*)(data + tail);
+		if (hdr->size - tail < sizeof(Record) || rec->reclen == 0) {
+			drop_oldest();
+			continue;
+		}
+		const char *pos = (const char*)(data + tail + sizeof(Record));
+		entry.topic = String(pos, (size_t)rec->topiclen);
+		pos += rec->topiclen;
+		entry.timestamp = String(pos, (size_t)rec->tslen);
+		pos += rec->tslen;
+		entry.message.assign(pos, rec->msglen);
+		entry.qos = rec->flags & 0x3;
+		entry.retain = (rec->flags & 0x4) != 0;
+		entry.offset = tail;
+		mtx.unlock();
+		return true;
+	}
+	mtx.unlock();
+	return false;
+}
+
+void
+Spool::pop(const Entry& entry)
+{
+	if (map == NULL) {
+		return;
+	}
+	mtx.lock();
+	// the entry might already be gone, if the spool overflowed meanwhile
+	if (hdr->used > 0 && hdr->tail == entry.offset) {
+		drop_oldest();
+	}
+	mtx.unlock();
+}
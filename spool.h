@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_SPOOL
+#define I_SPOOL
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <string>
+
+class Spool : public Base {
+public:
+	struct Entry {
+		String topic;
+		std::string message;
+		String timestamp;
+		int qos;
+		bool retain;
+		uint64_t offset;
+	};
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t size;
+		uint64_t head;
+		uint64_t tail;
+		uint64_t used;
+		uint64_t dropped;
+	};
+	struct Record {
+		uint32_t reclen;
+		uint32_t msglen;
+		uint16_t topiclen;
+		uint8_t tslen;
+		uint8_t flags;
+	};
+	int fd;
+	uint64_t mapsize;
+	uint8_t *map;
+	Header *hdr;
+	uint8_t *data;
+	Mutex mtx;
+
+	void drop_oldest();
+
+public:
+	Spool();
+	~Spool();
+	void open(const String& path, uint64_t size);
+	bool enabled();
+	bool empty();
+	void append(const String& topic, const void *payload, size_t len, int qos, bool retain, const String& timestamp);
+	bool peek(Entry& entry);
+	void pop(const Entry& entry);
+};
+
+#endif /* I_SPOOL */
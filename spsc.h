@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_SPSC
+#define I_SPSC
+
+#include <atomic>
+#include <utility>
+
+// lock-free ring for exactly one producer and one consumer thread
+template <class T, size_t N>
+class SPSCRing {
+private:
+	T slots[N];
+	std::atomic<size_t> head;
+	std::atomic<size_t> tail;
+
+public:
+	SPSCRing()
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	// producer side, the item is swapped into the ring on success
+	bool push(T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+		std::swap(slots[t % N], item);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side
+	bool empty() const
+	{
+		return (head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire));
+	}
+
+	bool pop(T& item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		std::swap(item, slots[h % N]);
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+#endif /* I_SPSC */
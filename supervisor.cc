@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "supervisor.h"
+#include <sys/wait.h>
+#ifdef __FreeBSD__
+#include <sys/procctl.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#define SHARD_VNODES 64
+#define SHARD_MAX_BACKOFF 60
+
+static volatile sig_atomic_t supervisor_terminate = 0;
+
+static void
+supervisor_signal(int sig)
+{
+	supervisor_terminate = 1;
+}
+
+static uint64_t
+fnv1a(const String& str)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	const char *p = str.c_str();
+	for (size_t i = 0; i < str.length(); i++) {
+		hash ^= (uint8_t)p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+int64_t
+Supervisor::shard_count(JSON& cfg)
+{
+	JSON& sv_cfg = cfg["supervisor"];
+	int64_t ret = 0;
+	if (sv_cfg.exists("processes")) {
+		ret = sv_cfg["processes"].get_numstr().getll();
+	}
+	if (ret < 1) {
+		ret = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (ret < 1) {
+		ret = 1;
+	}
+	return ret;
+}
+
+int64_t
+Supervisor::shard_of(const String& bus, int64_t nshards)
+{
+	// consistent hashing, so changing the number of processes only
+	// moves the buses of the added or removed shards
+	uint64_t hash = fnv1a(bus);
+	int64_t ret = 0;
+	int64_t lowest = 0;
+	uint64_t best = UINT64_MAX;
+	uint64_t lowest_point = UINT64_MAX;
+	for (int64_t i = 0; i < nshards; i++) {
+		for (int v = 0; v < SHARD_VNODES; v++) {
+			uint64_t point = fnv1a(S + "shard" + i + "/" + v);
+			if (point >= hash && point < best) {
+				best = point;
+				ret = i;
+			}
+			if (point < lowest_point) {
+				lowest_point = point;
+				lowest = i;
+			}
+		}
+	}
+	if (best == UINT64_MAX) {
+		// wrap around the ring
+		ret = lowest;
+	}
+	return ret;
+}
+
+Supervisor::Supervisor(const String& program, const String& configfile) : program(program), configfile(configfile)
+{
+	nshards = 0;
+}
+
+void
+Supervisor::spawn(int64_t no)
+{
+	Shard& shard = shards[no];
+
+	// prepare everything before fork, the child only execs
+	String shardno = S + no;
+	const char *args[] = {program.c_str(), "-c", configfile.c_str(), "-S", shardno.c_str(), NULL};
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		syslog(LOG_ERR, "failed to fork shard %jd: %s", (intmax_t)no, strerror(errno));
+		shard.next_start = time(NULL) + shard.backoff;
+		return;
+	}
+	if (pid == 0) {
+		// don't leave orphaned workers behind
+#ifdef __FreeBSD__
+		int sig = SIGTERM;
+		procctl(P_PID, 0, PROC_PDEATHSIG_CTL, &sig);
+#endif
+#ifdef __linux__
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+		execvp(args[0], (char* const*)args);
+		_exit(1);
+	}
+	shard.pid = pid;
+	shard.started = time(NULL);
+	syslog(LOG_INFO, "started shard %jd with pid %d", (intmax_t)no, (int)pid);
+}
+
+void
+Supervisor::reap(time_t now)
+{
+	pid_t pid;
+	int status;
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		for (int64_t i = 0; i < nshards; i++) {
+			Shard& shard = shards[i];
+			if (shard.pid != pid) {
+				continue;
+			}
+			syslog(LOG_ERR, "shard %jd (pid %d) exited with status %d", (intmax_t)i, (int)pid, status);
+			shard.pid = 0;
+			shard.restarts++;
+			// back off exponentially for workers dying right after start
+			if (now - shard.started >= SHARD_MAX_BACKOFF) {
+				shard.backoff = 1;
+			} else {
+				shard.backoff *= 2;
+				if (shard.backoff > SHARD_MAX_BACKOFF) {
+					shard.backoff = SHARD_MAX_BACKOFF;
+				}
+			}
+			shard.next_start = now + shard.backoff;
+		}
+	}
+}
+
+void
+Supervisor::stop()
+{
+	for (int64_t i = 0; i < nshards; i++) {
+		if (shards[i].pid > 0) {
+			kill(shards[i].pid, SIGTERM);
+		}
+	}
+	for (int64_t i = 0; i < nshards; i++) {
+		if (shards[i].pid > 0) {
+			int status;
+			waitpid(shards[i].pid, &status, 0);
+		}
+	}
+}
+
+void
+Supervisor::setup(JSON& cfg, MQTT& mqtt)
+{
+	nshards = shard_count(cfg);
+	for (int64_t i = 0; i < nshards; i++) {
+		Shard& shard = shards[i];
+		shard.pid = 0;
+		shard.restarts = 0;
+		shard.started = 0;
+		shard.next_start = 0;
+		shard.backoff = 1;
+	}
+	JSON& modbuses = cfg["modbuses"];
+	for (int64_t bus = 0; bus <= modbuses.get_array().max; bus++) {
+		String host = modbuses[bus]["host"];
+		String port = modbuses[bus]["port"];
+		String key = S + host + ":" + port;
+		shards[shard_of(key, nshards)].buses << key;
+	}
+
+	mqtt.subscribe(mqtt.maintopic + "/shard/+/status");
+}
+
+String
+Supervisor::check(MQTT& mqtt)
+{
+	// one round of restarting workers and reporting, returns the status
+	time_t now = time(NULL);
+	reap(now);
+
+	int64_t healthy = 0;
+	Array<JSON> details;
+	for (int64_t i = 0; i < nshards; i++) {
+		Shard& shard = shards[i];
+		if (shard.pid == 0 && shard.buses.max >= 0 && now >= shard.next_start) {
+			spawn(i);
+		}
+		// a worker counts as healthy once it reports online,
+		// until its first report there is no data for the topic
+		String status;
+		try {
+			status = mqtt[S + mqtt.maintopic + "/shard/" + i + "/status"];
+		} catch (...) {
+		}
+		if (shard.pid == 0) {
+			status = "stopped";
+		} else if (status.empty()) {
+			status = "starting";
+		}
+		if (shard.buses.max < 0 || status == "online") {
+			healthy++;
+		}
+		AArray<JSON> detail;
+		detail["status"] = status;
+		detail["pid"].set_number(S + shard.pid);
+		detail["restarts"].set_number(S + shard.restarts);
+		Array<JSON> buses;
+		for (int64_t j = 0; j <= shard.buses.max; j++) {
+			buses[j] = shard.buses[j];
+		}
+		detail["buses"] = buses;
+		details[i] = detail;
+	}
+	String status = "online";
+	if (healthy == 0) {
+		status = "offline";
+	} else if (healthy < nshards) {
+		status = "degraded";
+	}
+	mqtt.publish(mqtt.maintopic + "/status", status, true, true);
+	JSON shard_data;
+	shard_data = details;
+	mqtt.publish(mqtt.maintopic + "/shards", shard_data.generate(), true, true);
+	return status;
+}
+
+void
+Supervisor::run(JSON& cfg, MQTT& mqtt)
+{
+	setup(cfg, mqtt);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = supervisor_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+
+	for (;;) {
+		if (supervisor_terminate) {
+			stop();
+			mqtt.publish(mqtt.maintopic + "/status", "offline", true);
+			exit(0);
+		}
+		check(mqtt);
+		sleep(1);
+	}
+}
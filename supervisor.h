@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_SUPERVISOR
+#define I_SUPERVISOR
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include "mqtt.h"
+
+// Splits the buses across worker processes, which are restarted when
+// they die, and reports their health on the bridge status topic.
+class Supervisor : public Base {
+private:
+	struct Shard {
+		pid_t pid;
+		int64_t restarts;
+		time_t started;
+		time_t next_start;
+		int backoff;
+		Array<String> buses;
+	};
+	String program;
+	String configfile;
+	Array<Shard> shards;
+	int64_t nshards;
+
+	void spawn(int64_t no);
+	void reap(time_t now);
+
+public:
+	static int64_t shard_count(JSON& cfg);
+	static int64_t shard_of(const String& bus, int64_t nshards);
+
+	Supervisor(const String& program, const String& configfile);
+	void setup(JSON& cfg, MQTT& mqtt);
+	String check(MQTT& mqtt);
+	void stop();
+	void run(JSON& cfg, MQTT& mqtt);
+};
+
+#endif /* I_SUPERVISOR */
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "tcp.h"
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+int
+tcp_listen(const String& host, const String& port)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	struct addrinfo *res;
+	int rc = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &res);
+	if (rc != 0) {
+		throw Error(S + "getaddrinfo: " + gai_strerror(rc));
+	}
+	int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (fd < 0) {
+		freeaddrinfo(res);
+		throw Error(S + "socket failed: " + strerror(errno));
+	}
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (bind(fd, res->ai_addr, res->ai_addrlen) < 0 || listen(fd, 16) < 0) {
+		freeaddrinfo(res);
+		close(fd);
+		throw Error(S + "failed to listen on port " + port + ": " + strerror(errno));
+	}
+	freeaddrinfo(res);
+	return fd;
+}
+
+bool
+tcp_read(int fd, uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t rc = read(fd, buf, len);
+		if (rc <= 0) {
+			return false;
+		}
+		buf += rc;
+		len -= rc;
+	}
+	return true;
+}
+
+bool
+tcp_write(int fd, const uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t rc = write(fd, buf, len);
+		if (rc <= 0) {
+			return false;
+		}
+		buf += rc;
+		len -= rc;
+	}
+	return true;
+}
+
+TcpClients::TcpClients()
+{
+	count = 0;
+	max = 16;
+	idle = 60;
+}
+
+void
+TcpClients::setup(JSON& cfg)
+{
+	if (cfg.exists("max_clients")) {
+		max = cfg["max_clients"].get_numstr().getll();
+	}
+	if (cfg.exists("idle_timeout")) {
+		String tmp = cfg["idle_timeout"].get_numstr();
+		idle = tmp.getd();
+	}
+}
+
+bool
+TcpClients::add(int fd)
+{
+	mtx.lock();
+	bool ret = (count < max);
+	if (ret) {
+		count++;
+	}
+	mtx.unlock();
+	if (ret && idle > 0) {
+		// reads and writes fail after idle seconds
+		struct timeval tv;
+		tv.tv_sec = (time_t)idle;
+		tv.tv_usec = (suseconds_t)((idle - tv.tv_sec) * 1000000);
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	}
+	return ret;
+}
+
+void
+TcpClients::remove()
+{
+	mtx.lock();
+	count--;
+	mtx.unlock();
+}
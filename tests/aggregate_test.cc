@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "../main.h"
+#include "../aggregate.h"
+#include <math.h>
+#include "test.h"
+
+#define BASE 1700000040	// start of a minute
+
+static void
+sample(Aggregator& agg, MQTT& mqtt, double t, double power)
+{
+	JSON data;
+	data["power"].set_number(d_to_s(power, 3));
+	struct timespec tp;
+	tp.tv_sec = BASE + (time_t)t;
+	tp.tv_nsec = (t - (time_t)t) * 1000000000;
+	agg.update(data, tp, mqtt, "test", 0);
+}
+
+static bool
+published(MQTT& mqtt, JSON& agg_data)
+{
+	String msg;
+	if (!mqtt.sent("test/agg/60", msg)) {
+		return false;
+	}
+	agg_data.parse(msg);
+	return true;
+}
+
+static double
+value(JSON& agg_data, const char *name)
+{
+	String tmp = agg_data["values"]["power"][name].get_numstr();
+	return tmp.getd();
+}
+
+static void
+setup(Aggregator& agg)
+{
+	JSON cfg;
+	cfg.parse("{\"windows\": [60], \"fields\": [\"power\"], \"energy\": [\"power\"]}");
+	agg.setup(cfg, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	// 3600 W for one minute are 60 Wh, the interval crossing the window
+	// end is split between both windows
+	{
+		Aggregator agg;
+		MQTT mqtt;
+		setup(agg);
+		for (int t = 0; t < 60; t++) {
+			sample(agg, mqtt, t, 3600);
+		}
+		JSON agg_data;
+		CHECK(!published(mqtt, agg_data));
+		sample(agg, mqtt, 60.5, 3600);
+		CHECK(published(mqtt, agg_data));
+		CHECK(value(agg_data, "count") == 60);
+		CHECK(fabs(value(agg_data, "energy") - 60) < 0.001);
+	}
+
+	// no energy across an outage longer than max_gap, the window is
+	// closed by the timer
+	{
+		Aggregator agg;
+		MQTT mqtt;
+		setup(agg);
+		sample(agg, mqtt, 0, 3600);
+		sample(agg, mqtt, 1, 3600);
+		sample(agg, mqtt, 40, 3600);
+		sample(agg, mqtt, 41, 3600);
+		JSON agg_data;
+		struct timespec tp;
+		tp.tv_sec = BASE + 65;
+		tp.tv_nsec = 0;
+		agg.tick(tp, mqtt, "test", 0);
+		CHECK(!published(mqtt, agg_data));
+		tp.tv_sec = BASE + 70;
+		agg.tick(tp, mqtt, "test", 0);
+		CHECK(published(mqtt, agg_data));
+		CHECK(value(agg_data, "count") == 4);
+		CHECK(fabs(value(agg_data, "energy") - 2) < 0.001);
+		CHECK(value(agg_data, "min") == 3600);
+	}
+
+	return test_result("aggregate");
+}
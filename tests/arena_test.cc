@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../alloc.h"
+#include "test.h"
+#include <pthread.h>
+
+// keeps the compiler from eliding malloc and free pairs
+static void * volatile sink;
+
+static void*
+alloc(size_t size)
+{
+	sink = malloc(size);
+	return sink;
+}
+
+static void*
+release(void *arg)
+{
+	free(arg);
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	void *heap = alloc(64);
+	CHECK(!arena_contains(heap));
+
+	// the poll temporaries come from the arena, not from the heap
+	{
+		uint64_t allocations = alloc_count();
+		uint64_t arena_allocations = arena_count();
+		void *first;
+		{
+			ArenaScope scope(true);
+			first = alloc(100);
+			CHECK(arena_contains(first));
+			JSON data;
+			{
+				AArray<JSON> tmp;
+				data = tmp;
+			}
+			data["power"].set_number(S + 1234);
+			data["name"] = String("ETH-IO88");
+			free(first);
+		}
+		CHECK(alloc_count() == allocations);
+		CHECK(arena_count() > arena_allocations);
+
+		// nothing outlived the scope, so the arena starts over
+		{
+			ArenaScope scope(true);
+			void *again = alloc(100);
+			CHECK(again == first);
+			memset(again, 0xff, 100);
+			free(again);
+		}
+		ArenaScope scope(true);
+		unsigned char *zero = (unsigned char*)calloc(1, 100);
+		CHECK(zero == first);
+		bool cleared = true;
+		for (int i = 0; i < 100; i++) {
+			cleared = cleared && zero[i] == 0;
+		}
+		CHECK(cleared);
+		free(zero);
+	}
+
+	// memory freed after the scope, even by another thread, brings its
+	// chunk back, far more than the reserved address space gets cycled
+	{
+		uint64_t allocations = alloc_count();
+		void *pending = NULL;
+		for (int n = 0; n < 40000; n++) {
+			void *ptr;
+			{
+				ArenaScope scope(true);
+				ptr = alloc(4000);
+			}
+			free(pending);
+			pending = ptr;
+		}
+		CHECK(arena_contains(pending));
+		CHECK(alloc_count() == allocations);
+		pthread_t thread;
+		pthread_create(&thread, NULL, release, pending);
+		pthread_join(thread, NULL);
+	}
+
+	// arena memory moves to the heap when it grows outside of a scope
+	{
+		char *ptr;
+		{
+			ArenaScope scope(true);
+			ptr = (char*)alloc(16);
+			strcpy(ptr, "arena");
+		}
+		ptr = (char*)realloc(ptr, 1000);
+		CHECK(!arena_contains(ptr));
+		CHECK(strcmp(ptr, "arena") == 0);
+		free(ptr);
+	}
+
+	// large allocations go to the heap
+	{
+		ArenaScope scope(true);
+		uint64_t allocations = alloc_count();
+		void *large = alloc(1024 * 1024);
+		CHECK(!arena_contains(large));
+		CHECK(alloc_count() == allocations + 1);
+		free(large);
+	}
+
+	free(heap);
+	return test_result("arena");
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../bus.h"
+#include "../tcp.h"
+#include "test.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// answers from a script, one entry per request
+class ScriptTransport : public Transport {
+public:
+	// 0 answers, otherwise the error kind + 1 or an exception code + 0x100
+	Array<int> script;
+	int requests;
+	double timeouts[32];
+
+	ScriptTransport()
+	{
+		requests = 0;
+	}
+	void set_ignore_sequence(bool ignore_sequence)
+	{
+	}
+	void set_timeout(double seconds)
+	{
+		if (requests < 32) {
+			timeouts[requests] = seconds;
+		}
+	}
+	void next()
+	{
+		int action = (requests <= script.max) ? script[requests] : 0;
+		requests++;
+		if (action >= 0x100) {
+			throw ModbusException(action - 0x100);
+		}
+		if (action > 0) {
+			throw ModbusError((ModbusError::Kind)(action - 1), "scripted");
+		}
+	}
+	Array<uint16_t> read_input_registers(uint8_t address, uint16_t reg, uint16_t count)
+	{
+		next();
+		Array<uint16_t> ret;
+		for (int i = count - 1; i >= 0; i--) {
+			ret[i] = reg + i;
+		}
+		return ret;
+	}
+	Array<uint16_t> read_holding_registers(uint8_t address, uint16_t reg, uint16_t count)
+	{
+		return read_input_registers(address, reg, count);
+	}
+	Array<bool> read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count)
+	{
+		next();
+		Array<bool> ret;
+		for (int i = count - 1; i >= 0; i--) {
+			ret[i] = false;
+		}
+		return ret;
+	}
+	Array<bool> read_coils(uint8_t address, uint16_t reg, uint16_t count)
+	{
+		return read_discrete_inputs(address, reg, count);
+	}
+	uint16_t read_input_register(uint8_t address, uint16_t reg)
+	{
+		return read_input_registers(address, reg, 1)[0];
+	}
+	void write_coil(uint8_t address, uint16_t reg, bool value)
+	{
+		next();
+	}
+	void write_register(uint8_t address, uint16_t reg, uint16_t value)
+	{
+		next();
+	}
+	String identification(uint8_t address, uint8_t id)
+	{
+		next();
+		return "test";
+	}
+};
+
+int
+main(int argc, char *argv[])
+{
+	{
+		// a lost frame is retried within the budget
+		ScriptTransport *t = new ScriptTransport;
+		t->script[0] = 1 + ModbusError::TIMEOUT;
+		Bus mb(t);
+		mb.begin_poll();
+		Array<uint16_t> regs = mb.read_input_registers(1, 0x10, 2);
+		CHECK(regs[1] == 0x11);
+		CHECK(t->requests == 2);
+		// no response times yet, the 5s budget is split over both attempts
+		CHECK(t->timeouts[0] > 2.4 && t->timeouts[0] <= 2.5);
+		CHECK(!mb.poll_failed());
+	}
+	{
+		// exception replies are not retried
+		ScriptTransport *t = new ScriptTransport;
+		t->script[0] = 0x102;
+		Bus mb(t);
+		mb.set_retries(3);
+		mb.begin_poll();
+		bool caught = false;
+		try {
+			mb.read_holding_registers(1, 0x10, 2);
+		} catch (ModbusException& e) {
+			caught = (e.code == 0x02);
+		}
+		CHECK(caught);
+		CHECK(t->requests == 1);
+		CHECK(mb.poll_failed());
+	}
+	{
+		// connection errors are not retried either
+		ScriptTransport *t = new ScriptTransport;
+		t->script[0] = 1 + ModbusError::CONNECTION;
+		Bus mb(t);
+		bool caught = false;
+		try {
+			mb.read_coils(1, 0, 8);
+		} catch (ModbusError& e) {
+			caught = (e.kind == ModbusError::CONNECTION);
+		}
+		CHECK(caught);
+		CHECK(t->requests == 1);
+	}
+	{
+		// once the device is known the timeout follows its response times
+		ScriptTransport *t = new ScriptTransport;
+		Bus mb(t);
+		for (int i = 0; i < 20; i++) {
+			mb.read_input_registers(1, 0, 1);
+		}
+		CHECK(t->timeouts[15] <= 0.1);
+	}
+	{
+		// a failed write leaves the register unknown, even in a static block
+		ScriptTransport *t = new ScriptTransport;
+		t->script[1] = 1 + ModbusError::CONNECTION;
+		Bus mb(t);
+		mb.read_holding_registers(1, 0x10, 4, Bus::RATE_STATIC);
+		mb.read_holding_registers(1, 0x10, 4, Bus::RATE_STATIC);
+		CHECK(t->requests == 1);
+		try {
+			mb.write_register(1, 0x12, 7);
+		} catch (...) {
+		}
+		mb.read_holding_registers(1, 0x10, 4, Bus::RATE_STATIC);
+		CHECK(t->requests == 3);
+	}
+	{
+		// proxy traffic gets one attempt and leaves the statistics alone
+		ScriptTransport *t = new ScriptTransport;
+		t->script[0] = 1 + ModbusError::TIMEOUT;
+		Bus mb(t);
+		mb.begin_poll();
+		Array<uint16_t> regs;
+		Array<bool> bits;
+		bool caught = false;
+		try {
+			mb.direct(1, 0x03, 0x10, 2, regs, bits);
+		} catch (ModbusError& e) {
+			caught = (e.kind == ModbusError::TIMEOUT);
+		}
+		CHECK(caught);
+		CHECK(t->requests == 1);
+		CHECK(!mb.poll_failed());
+		JSON counters;
+		AArray<JSON> tmp;
+		counters = tmp;
+		mb.error_counters(1, counters);
+		CHECK(!counters.exists("block_errors"));
+		// only writes of the bridge count
+		uint64_t writes = mb.write_count(1);
+		mb.direct(1, 0x06, 0x10, 5, regs, bits);
+		CHECK(mb.write_count(1) == writes);
+		mb.write_register(1, 0x10, 6);
+		CHECK(mb.write_count(1) == writes + 1);
+	}
+	{
+		// a gateway that never answers fails after the timeout
+		int lfd = tcp_listen("127.0.0.1", "0");
+		struct sockaddr_in sin;
+		socklen_t len = sizeof(sin);
+		getsockname(lfd, (struct sockaddr *)&sin, &len);
+		ModbusTransport t("127.0.0.1", S + ntohs(sin.sin_port));
+		t.set_timeout(0.2);
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		bool timeout = false;
+		try {
+			t.read_holding_registers(1, 0, 1);
+		} catch (ModbusError& e) {
+			timeout = (e.kind == ModbusError::TIMEOUT);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		double elapsed = (t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1000000000;
+		CHECK(timeout);
+		CHECK(elapsed >= 0.19 && elapsed < 1);
+		close(lfd);
+	}
+
+	return test_result("bus");
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../counter.h"
+#include "test.h"
+
+int
+main(int argc, char *argv[])
+{
+	char path[] = "/tmp/counter_test.XXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	uint64_t total;
+	double rate;
+	{
+		CounterTracker counters;
+		counters.load(path);
+		CounterTracker::Group *grp = counters.group("gw:502/1");
+		int64_t slot = grp->slot("counters/0");
+		grp->update(slot, 65530, 16, 100, total, rate);
+		// a 16 bit counter wraps
+		grp->update(slot, 4, 16, 101, total, rate);
+		CHECK(total == 65540);
+		CHECK(rate == 10);
+		counters.save();
+	}
+	{
+		// the totals survive a restart, devices keep their own counters
+		CounterTracker counters;
+		counters.load(path);
+		CounterTracker::Group *other = counters.group("gw:502/2");
+		CHECK(other->slot("counters/0") == 0);
+		other->update(0, 7, 16, 102, total, rate);
+		CHECK(total == 7);
+		CounterTracker::Group *grp = counters.group("gw:502/1");
+		grp->update(grp->slot("counters/0"), 14, 16, 102, total, rate);
+		CHECK(total == 65550);
+	}
+	{
+		// a file of another layout is not loaded
+		fd = open(path, O_WRONLY | O_TRUNC);
+		uint32_t head[4] = {0x6d62636e, 1, 8, 1};
+		CHECK(write(fd, head, sizeof(head)) == sizeof(head));
+		close(fd);
+		CounterTracker counters;
+		counters.load(path);
+		CounterTracker::Group *grp = counters.group("gw:502/1");
+		grp->update(grp->slot("counters/0"), 14, 16, 102, total, rate);
+		CHECK(total == 14);
+	}
+	unlink(path);
+
+	return test_result("counter");
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "../main.h"
+#include "../encoder.h"
+#include "test.h"
+
+static std::string
+encode(const char *format, const char *json)
+{
+	Encoder enc;
+	enc.set_format(format);
+	JSON doc;
+	doc.parse(json);
+	return enc.encode(doc);
+}
+
+static bool
+bytes(const std::string& data, const char *hex)
+{
+	std::string expected;
+	for (const char *pos = hex; pos[0] != '\0' && pos[1] != '\0'; pos += 2) {
+		char tmp[3] = {pos[0], pos[1], '\0'};
+		expected.push_back((char)strtoul(tmp, NULL, 16));
+	}
+	return (data == expected);
+}
+
+int
+main(int argc, char *argv[])
+{
+	// small integers and floats
+	CHECK(bytes(encode("cbor", "{\"a\": 1}"), "a10001"));
+	CHECK(bytes(encode("msgpack", "{\"a\": 1}"), "810001"));
+	CHECK(bytes(encode("cbor", "{\"a\": -1}"), "a10020"));
+	CHECK(bytes(encode("msgpack", "{\"a\": -1}"), "8100ff"));
+	CHECK(bytes(encode("cbor", "{\"a\": 1.5}"), "a100fa3fc00000"));
+
+	// 64 bit counters keep every digit
+	CHECK(bytes(encode("cbor", "{\"a\": 18446744073709551615}"), "a1001bffffffffffffffff"));
+	CHECK(bytes(encode("msgpack", "{\"a\": 18446744073709551615}"), "8100cfffffffffffffffff"));
+	CHECK(bytes(encode("cbor", "{\"a\": 12345678901234567890}"), "a1001bab54a98ceb1f0ad2"));
+	CHECK(bytes(encode("cbor", "{\"a\": -9223372036854775808}"), "a1003b7fffffffffffffff"));
+	CHECK(bytes(encode("msgpack", "{\"a\": -9223372036854775808}"), "8100d38000000000000000"));
+
+	// beyond 64 bit only a double is left
+	CHECK(bytes(encode("cbor", "{\"a\": 100000000000000000000}"), "a100fb4415af1d78b58c40"));
+
+	// keys are replaced by their schema index
+	{
+		Encoder enc;
+		enc.set_format("cbor");
+		JSON doc;
+		doc.parse("{\"voltage\": 230}");
+		CHECK(bytes(enc.encode(doc), "a10018e6"));
+		CHECK(enc.schema_pending());
+		JSON schema;
+		schema.parse(enc.schema());
+		String key = schema["keys"][0];
+		CHECK(key == "voltage");
+		CHECK(!enc.schema_pending());
+		doc.parse("{\"current\": 2}");
+		CHECK(bytes(enc.encode(doc), "a10102"));
+		CHECK(enc.schema_pending());
+	}
+
+	return test_result("encoder");
+}
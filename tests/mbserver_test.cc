@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../mbserver.h"
+#include "../tcp.h"
+#include "test.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// reads count registers with function 3, returns the exception code or 0
+static int
+read_registers(int fd, uint8_t unit, uint16_t reg, uint16_t count, uint16_t *out)
+{
+	uint8_t req[12] = {0, 1, 0, 0, 0, 6, unit, 0x03, (uint8_t)(reg >> 8), (uint8_t)reg, 0, (uint8_t)count};
+	if (!tcp_write(fd, req, sizeof(req))) {
+		return -1;
+	}
+	uint8_t resp[260];
+	if (!tcp_read(fd, resp, 9)) {
+		return -1;
+	}
+	if (resp[7] & 0x80) {
+		return resp[8];
+	}
+	if (!tcp_read(fd, resp + 9, resp[8])) {
+		return -1;
+	}
+	for (int i = 0; i < count; i++) {
+		out[i] = (resp[9 + i * 2] << 8) | resp[10 + i * 2];
+	}
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	// writes to a client the server closed must not end the test
+	signal(SIGPIPE, SIG_IGN);
+
+	// find a free port
+	int pfd = tcp_listen("127.0.0.1", "0");
+	struct sockaddr_in sin;
+	socklen_t slen = sizeof(sin);
+	getsockname(pfd, (struct sockaddr *)&sin, &slen);
+	close(pfd);
+	String port = S + ntohs(sin.sin_port);
+
+	JSON cfg;
+	cfg.parse(S + "{\"listen\": \"127.0.0.1\", \"port\": " + port + ", \"max_clients\": 1, \"idle_timeout\": 0.5, \"map\": [" +
+	    "{\"unit\": 1, \"register\": 0, \"topic\": \"dev\", \"field\": \"power\", \"type\": \"int16\"}," +
+	    "{\"unit\": 1, \"register\": 1, \"topic\": \"dev\", \"field\": \"power\", \"type\": \"uint16\"}," +
+	    "{\"unit\": 1, \"register\": 2, \"topic\": \"dev\", \"field\": \"power\", \"type\": \"int32\", \"scale\": 1000000}," +
+	    "{\"unit\": 1, \"register\": 4, \"topic\": \"dev\", \"field\": \"current\", \"type\": \"uint32\"}," +
+	    "{\"unit\": 1, \"register\": 65535, \"topic\": \"dev\", \"field\": \"current\", \"type\": \"uint16\"}]}");
+	// the detached server threads run until exit, so the server is never
+	// destroyed
+	ModbusServer *server = new ModbusServer;
+	server->setup(cfg);
+	server->start();
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	CHECK(connect(fd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+
+	uint16_t regs[6];
+	// no data yet
+	CHECK(read_registers(fd, 1, 0, 1, regs) == 0x0b);
+	// not mapped
+	CHECK(read_registers(fd, 2, 0, 1, regs) == 0x02);
+
+	JSON data;
+	data.parse("{\"power\": -40000.5, \"current\": 12.7}");
+	server->update("dev", data);
+	CHECK(read_registers(fd, 1, 0, 6, regs) == 0);
+	// saturated instead of undefined casts
+	CHECK(regs[0] == 0x8000);
+	CHECK(regs[1] == 0);
+	CHECK(regs[2] == 0x8000 && regs[3] == 0x0000);
+	CHECK(regs[4] == 0 && regs[5] == 12);
+
+	// a range past the last register doesn't wrap to the first one
+	CHECK(read_registers(fd, 1, 65535, 1, regs) == 0);
+	CHECK(read_registers(fd, 1, 65535, 2, regs) == 0x02);
+
+	// only one client at a time
+	int fd2 = socket(AF_INET, SOCK_STREAM, 0);
+	CHECK(connect(fd2, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	CHECK(read_registers(fd2, 1, 0, 1, regs) == -1);
+	close(fd2);
+
+	// an offline device doesn't serve stale values
+	server->invalidate("dev");
+	CHECK(read_registers(fd, 1, 4, 2, regs) == 0x0b);
+
+	// an idle client is disconnected, which makes room for another one
+	usleep(800000);
+	CHECK(read_registers(fd, 1, 4, 2, regs) == -1);
+	close(fd);
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	CHECK(connect(fd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	CHECK(read_registers(fd, 1, 4, 2, regs) == 0x0b);
+
+	close(fd);
+	return test_result("mbserver");
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../device.h"
+#include "../clock.h"
+#include "../alloc.h"
+#include "../bench/fake.h"
+#include "test.h"
+
+// one poll and publish of an ETH-IO88 with an output command, as the bus
+// thread and the worker pool of a realtime bus do it, returns the heap
+// allocations
+static uint64_t
+cycle(Bus& mb, Device& dev, bool arena)
+{
+	// commands are received by the MQTT thread
+	Array<MQTT::RXbuf> rxbuf;
+	rxbuf[0].topic = dev.cmd_topic;
+	rxbuf[0].message = "{\"output\": [true, false, true, false, true, false, true, false]}";
+
+	uint64_t allocations = alloc_count();
+	JSON job_data;
+	{
+		ArenaScope arena_scope(arena);
+		JSON mqtt_data;
+		{
+			AArray<JSON> tmp;
+			mqtt_data = tmp;
+		}
+		mqtt_data["vendor"] = dev.vendor;
+		mqtt_data["product"] = dev.product;
+		mqtt_data["version"] = dev.version;
+		mb.begin_poll();
+		(*dev.handler)(mb, rxbuf, mqtt_data, dev.address, dev, *dev.cfg);
+		mb.error_counters(dev.address, mqtt_data);
+		struct timespec tp;
+		clock_gettime(CLOCK_REALTIME, &tp);
+		mqtt_data["time"] = clock_string(tp.tv_sec);
+		std::swap(job_data, mqtt_data);
+	}
+	{
+		ArenaScope arena_scope(arena);
+		const std::string& data = dev.encoder.encode(job_data);
+		dev.mqtt.publish_raw(dev.data_topic, data.data(), data.length(), false, 0);
+		String json = job_data.generate();
+		dev.mqtt.publish_raw(dev.data_topic, json.c_str(), json.length(), false, 0);
+		dev.mqtt.publish(dev.status_topic, "online", false, false, 0);
+	}
+	return alloc_count() - allocations;
+}
+
+int
+main(int argc, char *argv[])
+{
+	AArray<AArray<devfunction>> devfunctions;
+	register_handlers(devfunctions);
+
+	FakeTransport *fake = new FakeTransport;
+	fake->synthesize(1, "Bernd Walter Computer Technology", "ETH-IO88", "1.10");
+	Bus mb(fake);
+	JSON dev_cfg;
+	{
+		AArray<JSON> tmp;
+		dev_cfg = tmp;
+	}
+	Device dev;
+	dev.cfg = &dev_cfg;
+	dev.address = 1;
+	dev.vendor = "Bernd Walter Computer Technology";
+	dev.product = "ETH-IO88";
+	dev.version = "1.10";
+	dev.major = 1;
+	dev.minor = 10;
+	dev.handler = devfunctions[dev.vendor][dev.product];
+	dev.data_topic = "test/data";
+	dev.status_topic = "test/status";
+	dev.cmd_topic = "test/cmd";
+	dev.encoder.set_format("cbor");
+
+	// without the arena the same cycle allocates
+	CHECK(cycle(mb, dev, false) > 0);
+
+	// once warmed up not a single allocation may go to the heap
+	for (int n = 0; n < 10; n++) {
+		cycle(mb, dev, true);
+	}
+	uint64_t arena_allocations = arena_count();
+	uint64_t allocations = 0;
+	for (int n = 0; n < 10000; n++) {
+		allocations += cycle(mb, dev, true);
+	}
+	CHECK(allocations == 0);
+	CHECK(arena_count() > arena_allocations);
+
+	return test_result("realtime");
+}
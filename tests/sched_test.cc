@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../sched.h"
+#include "../alloc.h"
+#include "test.h"
+
+int
+main(int argc, char *argv[])
+{
+	BusScheduler sched;
+	JSON report;
+	CHECK(!sched.report(0, 0, report));
+
+	// 0.5us, 3us, 3us and 1ms late, early wakeups count as on time
+	sched.wakeup_latency(0.0000005);
+	sched.wakeup_latency(0.000003);
+	sched.wakeup_latency(0.000003);
+	sched.wakeup_latency(0.001);
+	sched.wakeup_latency(-0.001);
+	CHECK(sched.report(10, 1, report));
+	CHECK(report.exists("wakeup_latency_us"));
+	if (report.exists("wakeup_latency_us")) {
+		JSON& hist = report["wakeup_latency_us"];
+		String n2 = hist["2"].get_numstr();
+		String n4 = hist["4"].get_numstr();
+		String n1024 = hist["1024"].get_numstr();
+		CHECK(n2.getll() == 2);
+		CHECK(n4.getll() == 2);
+		CHECK(n1024.getll() == 1);
+	}
+
+	// a fast device gets polled twice as often as a telemetry one
+	Array<int> due;
+	due[0] = BusScheduler::PRIO_FAST;
+	due[1] = BusScheduler::PRIO_TELEMETRY;
+	int64_t polls[2] = {0, 0};
+	for (int n = 0; n < 300; n++) {
+		int64_t i = sched.select(due);
+		polls[i]++;
+		sched.account(i, due[i], 0.01);
+	}
+	CHECK(polls[0] == 200);
+	CHECK(polls[1] == 100);
+
+	// the idle path of a realtime bus doesn't allocate once warmed up,
+	// the polls themselves still do
+	uint64_t allocations = alloc_count();
+	for (int n = 0; n < 1000; n++) {
+		int64_t i = sched.select(due);
+		sched.account(i, due[i], 0.01);
+		sched.wakeup_latency(0.00001);
+	}
+	CHECK(alloc_count() == allocations);
+
+	return test_result("sched");
+}
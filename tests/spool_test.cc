@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "../main.h"
+#include "../spool.h"
+#include "test.h"
+
+int
+main(int argc, char *argv[])
+{
+	char path[] = "/tmp/spool_test.XXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	{
+		Spool spool;
+		spool.open(path, 4096);
+		CHECK(spool.empty());
+		// binary payloads may contain NUL bytes
+		const char payload[] = {'a', '\0', 'b', '\xff'};
+		spool.append("dev/data/zstd", payload, sizeof(payload), 1, false, "2026-10-19T08:00:00");
+		CHECK(!spool.empty());
+	}
+	{
+		// the content survives reopening
+		Spool spool;
+		spool.open(path, 4096);
+		Spool::Entry entry;
+		CHECK(spool.peek(entry));
+		CHECK(entry.topic == "dev/data/zstd");
+		CHECK(entry.timestamp == "2026-10-19T08:00:00");
+		CHECK(entry.message == std::string("a\0b\xff", 4));
+		CHECK(entry.qos == 1);
+		spool.pop(entry);
+		CHECK(spool.empty());
+	}
+	unlink(path);
+
+	return test_result("spool");
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "../main.h"
+#include "../supervisor.h"
+#include "test.h"
+#include <sys/wait.h>
+
+int
+main(int argc, char *argv[])
+{
+	// a worker that never reports
+	char worker[] = "/tmp/supervisor_test.XXXXXX";
+	int fd = mkstemp(worker);
+	CHECK(fd >= 0);
+	const char script[] = "#!/bin/sh\nexec sleep 30 </dev/null >/dev/null 2>&1\n";
+	CHECK(write(fd, script, sizeof(script) - 1) == sizeof(script) - 1);
+	fchmod(fd, 0755);
+	close(fd);
+
+	JSON cfg;
+	cfg.parse("{\"supervisor\": {\"processes\": 1}, \"modbuses\": [{\"host\": \"gw\", \"port\": \"502\"}]}");
+	MQTT mqtt;
+	mqtt.maintopic = "test";
+	Supervisor sv(worker, "/dev/null");
+	sv.setup(cfg, mqtt);
+
+	// no status of the shard yet must not stop the supervisor
+	String status;
+	try {
+		status = sv.check(mqtt);
+	} catch (...) {
+		status = "exception";
+	}
+	CHECK(status == "offline");
+
+	// the worker reports online
+	MQTT::RXbuf rx;
+	rx.topic = "test/shard/0/status";
+	rx.message = "online";
+	mqtt.message_callback(rx);
+	try {
+		status = sv.check(mqtt);
+	} catch (...) {
+		status = "exception";
+	}
+	CHECK(status == "online");
+
+	sv.stop();
+	unlink(worker);
+
+	return test_result("supervisor");
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "trace.h"
+
+#define TRACE_EVENTS 16384
+
+struct TraceEvent {
+	const char *name;
+	uint64_t start;
+	uint64_t end;
+};
+
+struct TraceBuffer {
+	String name;
+	int64_t tid;
+	std::atomic<uint64_t> count;
+	// allocated with the first event, threads never traced don't pay for it
+	std::atomic<TraceEvent*> events;
+};
+
+std::atomic<bool> trace_enabled(false);
+
+static Mutex trace_mtx;
+static Array<TraceBuffer*> trace_buffers;
+static thread_local TraceBuffer *trace_buffer = NULL;
+static String trace_file;
+static double trace_ticks_per_us = 1000;
+static uint64_t trace_base;
+static volatile sig_atomic_t trace_dump_flag = 0;
+
+static void
+trace_signal(int sig)
+{
+	if (sig == SIGUSR1) {
+		trace_dump_flag = 1;
+	} else {
+		trace_enabled = !trace_enabled;
+	}
+}
+
+static TraceBuffer*
+trace_get_buffer()
+{
+	if (trace_buffer == NULL) {
+		TraceBuffer *tb = new TraceBuffer;
+		tb->count = 0;
+		tb->events = NULL;
+		trace_mtx.lock();
+		tb->tid = trace_buffers.max + 1;
+		tb->name = S + "thread" + tb->tid;
+		trace_buffers[tb->tid] = tb;
+		trace_mtx.unlock();
+		trace_buffer = tb;
+	}
+	return trace_buffer;
+}
+
+void
+trace_setup(const String& file, bool enabled)
+{
+	trace_file = file;
+
+	// calibrate the tick rate against the monotonic clock
+	struct timespec tp0, tp1;
+	clock_gettime(CLOCK_MONOTONIC, &tp0);
+	uint64_t t0 = trace_ticks();
+	usleep(50000);
+	clock_gettime(CLOCK_MONOTONIC, &tp1);
+	uint64_t t1 = trace_ticks();
+	double us = (double)(tp1.tv_sec - tp0.tv_sec) * 1000000 + (double)(tp1.tv_nsec - tp0.tv_nsec) / 1000;
+	if (us > 0 && t1 > t0) {
+		trace_ticks_per_us = (double)(t1 - t0) / us;
+	}
+	trace_base = t0;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = trace_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+	sigaction(SIGUSR2, &sa, NULL);
+
+	trace_enabled = enabled;
+}
+
+void
+trace_thread(const String& name)
+{
+	TraceBuffer *tb = trace_get_buffer();
+	trace_mtx.lock();
+	tb->name = name;
+	trace_mtx.unlock();
+}
+
+void
+trace_record(const char *name, uint64_t start, uint64_t end)
+{
+	TraceBuffer *tb = trace_get_buffer();
+	TraceEvent *events = tb->events.load(std::memory_order_relaxed);
+	if (events == NULL) {
+		events = new TraceEvent[TRACE_EVENTS];
+		tb->events.store(events, std::memory_order_release);
+	}
+	uint64_t n = tb->count.load(std::memory_order_relaxed);
+	TraceEvent& ev = events[n % TRACE_EVENTS];
+	ev.name = name;
+	ev.start = start;
+	ev.end = end;
+	tb->count.store(n + 1, std::memory_order_release);
+}
+
+bool
+trace_dump_requested()
+{
+	if (trace_dump_flag) {
+		trace_dump_flag = 0;
+		return true;
+	}
+	return false;
+}
+
+void
+trace_dump()
+{
+	String tmpfile = trace_file + ".tmp";
+	FILE *f = fopen(tmpfile.c_str(), "w");
+	if (f == NULL) {
+		syslog(LOG_ERR, "failed to write trace %s", tmpfile.c_str());
+		return;
+	}
+	pid_t pid = getpid();
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool first = true;
+	trace_mtx.lock();
+	for (int64_t i = 0; i <= trace_buffers.max; i++) {
+		TraceBuffer *tb = trace_buffers[i];
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%jd,\"args\":{\"name\":\"%s\"}}",
+		    first ? "" : ",\n", (int)pid, (intmax_t)tb->tid, tb->name.c_str());
+		first = false;
+		uint64_t n = tb->count.load(std::memory_order_acquire);
+		const TraceEvent *events = tb->events.load(std::memory_order_acquire);
+		if (events == NULL) {
+			continue;
+		}
+		uint64_t from = 0;
+		if (n > TRACE_EVENTS) {
+			// the oldest entries may get overwritten while we read
+			from = n - TRACE_EVENTS + 64;
+		}
+		for (uint64_t j = from; j < n; j++) {
+			const TraceEvent& ev = events[j % TRACE_EVENTS];
+			if (ev.start < trace_base || ev.end < ev.start) {
+				continue;
+			}
+			double ts = (double)(ev.start - trace_base) / trace_ticks_per_us;
+			double dur = (double)(ev.end - ev.start) / trace_ticks_per_us;
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%jd,\"ts\":%.3f,\"dur\":%.3f}",
+			    ev.name, (int)pid, (intmax_t)tb->tid, ts, dur);
+		}
+	}
+	trace_mtx.unlock();
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	if (rename(tmpfile.c_str(), trace_file.c_str()) < 0) {
+		syslog(LOG_ERR, "failed to rename trace %s", trace_file.c_str());
+	}
+}
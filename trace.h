@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_TRACE
+#define I_TRACE
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+#include <atomic>
+#if defined(__amd64__) || defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Spans are recorded into per thread rings and dumped as Chrome trace
+// events on SIGUSR1, SIGUSR2 toggles recording.
+// A span costs a relaxed load while tracing is disabled.
+extern std::atomic<bool> trace_enabled;
+
+void trace_setup(const String& file, bool enabled);
+void trace_thread(const String& name);
+void trace_record(const char *name, uint64_t start, uint64_t end);
+bool trace_dump_requested();
+void trace_dump();
+
+static inline uint64_t
+trace_ticks()
+{
+#if defined(__amd64__) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000000 + tp.tv_nsec;
+#endif
+}
+
+// name must be a string literal, only the pointer is recorded
+class TraceSpan {
+private:
+	const char *name;
+	uint64_t start;
+
+public:
+	TraceSpan(const char *name) : name(name), start(0)
+	{
+		if (trace_enabled.load(std::memory_order_relaxed)) {
+			start = trace_ticks();
+		}
+	}
+
+	~TraceSpan()
+	{
+		if (start != 0) {
+			trace_record(name, start, trace_ticks());
+		}
+	}
+};
+
+#endif /* I_TRACE */
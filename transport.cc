@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "main.h"
+#include "transport.h"
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+
+ModbusError::ModbusError(Kind kind, const String& msg, uint8_t code) : Error(msg)
+{
+	this->kind = kind;
+	this->code = code;
+}
+
+bool
+ModbusError::retryable() const
+{
+	return (kind == TIMEOUT || kind == FRAME);
+}
+
+ModbusException::ModbusException(uint8_t code) : ModbusError(EXCEPTION, S + "modbus exception " + code, code)
+{
+}
+
+static void
+check_exception(uint8_t code)
+{
+	switch (code) {
+	case 0x0a:
+		throw ModbusError(ModbusError::CONNECTION, "gateway path unavailable", code);
+	case 0x0b:
+		throw ModbusError(ModbusError::TIMEOUT, "gateway target failed to respond", code);
+	default:
+		throw ModbusException(code);
+	}
+}
+
+ModbusTransport::ModbusTransport(const String& host, const String& port)
+{
+	this->host = host;
+	this->port = port;
+	fd = -1;
+	tid = 0;
+	ignore_sequence = false;
+	timeout = 5;
+}
+
+ModbusTransport::~ModbusTransport()
+{
+	disconnect();
+}
+
+double
+ModbusTransport::now()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (double)tp.tv_sec + (double)tp.tv_nsec / 1000000000;
+}
+
+void
+ModbusTransport::set_ignore_sequence(bool ignore_sequence)
+{
+	this->ignore_sequence = ignore_sequence;
+}
+
+void
+ModbusTransport::set_timeout(double seconds)
+{
+	timeout = seconds;
+}
+
+void
+ModbusTransport::disconnect()
+{
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+}
+
+bool
+ModbusTransport::wait(short events, double deadline)
+{
+	for (;;) {
+		double left = deadline - now();
+		if (left <= 0) {
+			return false;
+		}
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = events;
+		pfd.revents = 0;
+		int rc = poll(&pfd, 1, (int)(left * 1000) + 1);
+		if (rc > 0) {
+			return true;
+		}
+		if (rc < 0 && errno != EINTR) {
+			disconnect();
+			throw ModbusError(ModbusError::CONNECTION, S + "poll failed: " + strerror(errno));
+		}
+	}
+}
+
+// frees the address list however connect is left
+struct AddrinfoGuard {
+	struct addrinfo *res;
+
+	AddrinfoGuard(struct addrinfo *res) : res(res)
+	{
+	}
+	~AddrinfoGuard()
+	{
+		freeaddrinfo(res);
+	}
+};
+
+void
+ModbusTransport::connect(double deadline)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *res;
+	int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+	if (rc != 0) {
+		throw ModbusError(ModbusError::CONNECTION, S + "getaddrinfo: " + gai_strerror(rc));
+	}
+	AddrinfoGuard guard(res);
+	for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0) {
+			continue;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+		if (errno == EINPROGRESS && wait(POLLOUT, deadline)) {
+			int err = 0;
+			socklen_t len = sizeof(err);
+			getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+			if (err == 0) {
+				break;
+			}
+		}
+		disconnect();
+	}
+	if (fd < 0) {
+		if (now() >= deadline) {
+			throw ModbusError(ModbusError::TIMEOUT, S + "connect to " + host + ":" + port + " timed out");
+		}
+		throw ModbusError(ModbusError::CONNECTION, S + "connect to " + host + ":" + port + " failed");
+	}
+}
+
+void
+ModbusTransport::drain()
+{
+	// late replies of requests we already gave up on
+	uint8_t buf[260];
+	for (;;) {
+		ssize_t rc = read(fd, buf, sizeof(buf));
+		if (rc > 0) {
+			continue;
+		}
+		if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+			return;
+		}
+		// closed by the gateway, reconnect with the next request
+		disconnect();
+		return;
+	}
+}
+
+void
+ModbusTransport::send(const uint8_t *buf, size_t len, double deadline)
+{
+	while (len > 0) {
+		ssize_t rc = write(fd, buf, len);
+		if (rc > 0) {
+			buf += rc;
+			len -= rc;
+			continue;
+		}
+		if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+			if (!wait(POLLOUT, deadline)) {
+				disconnect();
+				throw ModbusError(ModbusError::TIMEOUT, "send timed out");
+			}
+			continue;
+		}
+		disconnect();
+		throw ModbusError(ModbusError::CONNECTION, S + "send failed: " + strerror(errno));
+	}
+}
+
+void
+ModbusTransport::receive(uint8_t *buf, size_t len, double deadline, bool partial)
+{
+	// partial is set when the frame has already started
+	while (len > 0) {
+		ssize_t rc = read(fd, buf, len);
+		if (rc > 0) {
+			buf += rc;
+			len -= rc;
+			partial = true;
+			continue;
+		}
+		if (rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+			if (!wait(POLLIN, deadline)) {
+				// we can't resync in the middle of a frame
+				if (partial) {
+					disconnect();
+				}
+				throw ModbusError(ModbusError::TIMEOUT, "response timed out");
+			}
+			continue;
+		}
+		disconnect();
+		throw ModbusError(ModbusError::CONNECTION, "connection closed");
+	}
+}
+
+size_t
+ModbusTransport::request(uint8_t address, const uint8_t *pdu, size_t len, uint8_t *reply)
+{
+	double deadline = now() + timeout;
+	if (fd >= 0) {
+		drain();
+	}
+	if (fd < 0) {
+		connect(deadline);
+	}
+	tid++;
+	uint8_t frame[260];
+	frame[0] = tid >> 8;
+	frame[1] = tid;
+	frame[2] = 0;
+	frame[3] = 0;
+	frame[4] = (len + 1) >> 8;
+	frame[5] = len + 1;
+	frame[6] = address;
+	memcpy(frame + 7, pdu, len);
+	send(frame, len + 7, deadline);
+	for (;;) {
+		uint8_t head[7];
+		receive(head, sizeof(head), deadline, false);
+		uint16_t rtid = (uint16_t)head[0] << 8 | head[1];
+		uint16_t rlen = (uint16_t)head[4] << 8 | head[5];
+		if (head[2] != 0 || head[3] != 0 || rlen < 3 || rlen > 254) {
+			disconnect();
+			throw ModbusError(ModbusError::FRAME, "invalid MBAP header");
+		}
+		receive(reply, rlen - 1, deadline, true);
+		if ((!ignore_sequence && rtid != tid) || head[6] != address) {
+			// answer to a request we already gave up on
+			continue;
+		}
+		if (reply[0] == (pdu[0] | 0x80)) {
+			check_exception(reply[1]);
+		}
+		if (reply[0] != pdu[0]) {
+			throw ModbusError(ModbusError::FRAME, S + "unexpected function " + reply[0]);
+		}
+		return rlen - 1;
+	}
+}
+
+Array<uint16_t>
+ModbusTransport::read_registers(uint8_t function, uint8_t address, uint16_t reg, uint16_t count)
+{
+	uint8_t pdu[5] = {function, (uint8_t)(reg >> 8), (uint8_t)reg, (uint8_t)(count >> 8), (uint8_t)count};
+	uint8_t reply[254];
+	size_t len = request(address, pdu, sizeof(pdu), reply);
+	if (len != 2 + (size_t)count * 2 || reply[1] != count * 2) {
+		throw ModbusError(ModbusError::FRAME, "invalid register response length");
+	}
+	Array<uint16_t> ret;
+	for (int i = count - 1; i >= 0; i--) {
+		ret[i] = (uint16_t)reply[2 + i * 2] << 8 | reply[3 + i * 2];
+	}
+	return ret;
+}
+
+Array<bool>
+ModbusTransport::read_bits(uint8_t function, uint8_t address, uint16_t reg, uint16_t count)
+{
+	uint8_t pdu[5] = {function, (uint8_t)(reg >> 8), (uint8_t)reg, (uint8_t)(count >> 8), (uint8_t)count};
+	uint8_t reply[254];
+	size_t len = request(address, pdu, sizeof(pdu), reply);
+	size_t bytes = (count + 7) / 8;
+	if (len != 2 + bytes || reply[1] != bytes) {
+		throw ModbusError(ModbusError::FRAME, "invalid bit response length");
+	}
+	Array<bool> ret;
+	for (int i = count - 1; i >= 0; i--) {
+		ret[i] = (reply[2 + i / 8] >> (i % 8)) & 1;
+	}
+	return ret;
+}
+
+void
+ModbusTransport::write_single(uint8_t function, uint8_t address, uint16_t reg, uint16_t value)
+{
+	uint8_t pdu[5] = {function, (uint8_t)(reg >> 8), (uint8_t)reg, (uint8_t)(value >> 8), (uint8_t)value};
+	uint8_t reply[254];
+	size_t len = request(address, pdu, sizeof(pdu), reply);
+	if (len != sizeof(pdu) || memcmp(reply, pdu, sizeof(pdu)) != 0) {
+		throw ModbusError(ModbusError::FRAME, "write not confirmed");
+	}
+}
+
+Array<uint16_t>
+ModbusTransport::read_input_registers(uint8_t address, uint16_t reg, uint16_t count)
+{
+	return read_registers(0x04, address, reg, count);
+}
+
+Array<uint16_t>
+ModbusTransport::read_holding_registers(uint8_t address, uint16_t reg, uint16_t count)
+{
+	return read_registers(0x03, address, reg, count);
+}
+
+Array<bool>
+ModbusTransport::read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count)
+{
+	return read_bits(0x02, address, reg, count);
+}
+
+Array<bool>
+ModbusTransport::read_coils(uint8_t address, uint16_t reg, uint16_t count)
+{
+	return read_bits(0x01, address, reg, count);
+}
+
+uint16_t
+ModbusTransport::read_input_register(uint8_t address, uint16_t reg)
+{
+	return read_registers(0x04, address, reg, 1)[0];
+}
+
+void
+ModbusTransport::write_coil(uint8_t address, uint16_t reg, bool value)
+{
+	write_single(0x05, address, reg, value ? 0xff00 : 0x0000);
+}
+
+void
+ModbusTransport::write_register(uint8_t address, uint16_t reg, uint16_t value)
+{
+	write_single(0x06, address, reg, value);
+}
+
+String
+ModbusTransport::identification(uint8_t address, uint8_t id)
+{
+	// read device identification, individual access to one object
+	uint8_t pdu[4] = {0x2b, 0x0e, 0x04, id};
+	uint8_t reply[254];
+	size_t len = request(address, pdu, sizeof(pdu), reply);
+	if (len < 9 || reply[1] != 0x0e || reply[6] < 1 || reply[7] != id || len < 9 + (size_t)reply[8]) {
+		throw ModbusError(ModbusError::FRAME, "invalid identification response");
+	}
+	return String((const char *)reply + 9, (size_t)reply[8]);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 Bernd Walter Computer Technology
+ * http://www.bwct.de
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef I_TRANSPORT
+#define I_TRANSPORT
+
+#include "main.h"
+#include <bwctmb/bwctmb.h>
+
+// why a Modbus request failed, a lost or garbled frame is worth another
+// attempt, an exception reply of the device will not change on retry
+class ModbusError : public Error {
+public:
+	enum Kind {
+		TIMEOUT,
+		CONNECTION,
+		FRAME,
+		EXCEPTION
+	};
+	Kind kind;
+	uint8_t code;
+
+	ModbusError(Kind kind, const String& msg, uint8_t code = 0);
+	bool retryable() const;
+};
+
+// exception reply of the device itself, gateway exceptions 0x0a and 0x0b
+// are reported as CONNECTION and TIMEOUT instead
+class ModbusException : public ModbusError {
+public:
+	ModbusException(uint8_t code);
+};
+
+// the Modbus requests a Bus needs, so handlers can run against
+// something else than a gateway
+class Transport : public Base {
+public:
+	virtual ~Transport()
+	{
+	}
+	virtual void set_ignore_sequence(bool ignore_sequence) = 0;
+	// limit for the next request including connecting
+	virtual void set_timeout(double seconds) = 0;
+	virtual Array<uint16_t> read_input_registers(uint8_t address, uint16_t reg, uint16_t count) = 0;
+	virtual Array<uint16_t> read_holding_registers(uint8_t address, uint16_t reg, uint16_t count) = 0;
+	virtual Array<bool> read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count) = 0;
+	virtual Array<bool> read_coils(uint8_t address, uint16_t reg, uint16_t count) = 0;
+	virtual uint16_t read_input_register(uint8_t address, uint16_t reg) = 0;
+	virtual void write_coil(uint8_t address, uint16_t reg, bool value) = 0;
+	virtual void write_register(uint8_t address, uint16_t reg, uint16_t value) = 0;
+	virtual String identification(uint8_t address, uint8_t id) = 0;
+};
+
+// Modbus/TCP client with a deadline per request, so the Bus can
+// decide how long a single attempt may take
+class ModbusTransport : public Transport {
+private:
+	String host;
+	String port;
+	int fd;
+	uint16_t tid;
+	bool ignore_sequence;
+	double timeout;
+
+	static double now();
+	void connect(double deadline);
+	void disconnect();
+	void drain();
+	bool wait(short events, double deadline);
+	void send(const uint8_t *buf, size_t len, double deadline);
+	void receive(uint8_t *buf, size_t len, double deadline, bool partial);
+	size_t request(uint8_t address, const uint8_t *pdu, size_t len, uint8_t *reply);
+	Array<uint16_t> read_registers(uint8_t function, uint8_t address, uint16_t reg, uint16_t count);
+	Array<bool> read_bits(uint8_t function, uint8_t address, uint16_t reg, uint16_t count);
+	void write_single(uint8_t function, uint8_t address, uint16_t reg, uint16_t value);
+
+public:
+	ModbusTransport(const String& host, const String& port);
+	~ModbusTransport();
+	void set_ignore_sequence(bool ignore_sequence);
+	void set_timeout(double seconds);
+	Array<uint16_t> read_input_registers(uint8_t address, uint16_t reg, uint16_t count);
+	Array<uint16_t> read_holding_registers(uint8_t address, uint16_t reg, uint16_t count);
+	Array<bool> read_discrete_inputs(uint8_t address, uint16_t reg, uint16_t count);
+	Array<bool> read_coils(uint8_t address, uint16_t reg, uint16_t count);
+	uint16_t read_input_register(uint8_t address, uint16_t reg);
+	void write_coil(uint8_t address, uint16_t reg, bool value);
+	void write_register(uint8_t address, uint16_t reg, uint16_t value);
+	String identification(uint8_t address, uint8_t id);
+};
+
+#endif /* I_TRANSPORT */